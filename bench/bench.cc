@@ -0,0 +1,180 @@
+
+/**
+ * @brief Host benchmarks for the firmware's hot paths.
+ *
+ * Build and run with 'pio run -e native && .pio/build/native/program'.
+ * Each benchmark reports the host time per call (useful for comparing
+ * two versions of the code on the same machine, not as an AVR number)
+ * and the number of digitalWrite() calls and pin toggles per call, which
+ * are the same on the host and the AVR. A benchmark that toggles pins
+ * more often than its budget fails and the program exits with status 1,
+ * so this can be used as a gate before flashing a batch of clocks.
+ */
+
+#include <Arduino.h>
+
+#include <chrono>
+
+#include "native_hal.h"
+#include "RTC.h"
+#include "brightness.h"
+#include "display.h"
+#include "mode_switch.h"
+#include "pins.h"
+#include "print.h"
+#include "shift_register.h"
+
+#define DEFAULT_ITERATIONS 100000
+
+// Defined in src/, but not declared in a header
+void setup();
+void loop();
+void update_display_with_time();
+
+struct benchmark {
+    const char *name;
+    void (*run)();
+    // Max pin toggles per call; the regression gate
+    double toggle_budget;
+};
+
+// One half of the 1Hz square wave. The RTC moves forward one second on
+// the rising edge so the digits change as they do on a clock.
+static void sqw_edge(int level) {
+    static uint32_t rtc_time = 1723680000;  // 8/15/24 00:00:00
+    if (level == HIGH)
+        hal_rtc_set(++rtc_time);
+    hal_advance_millis(500);
+    hal_fire_pin(CLOCK_1HZ, level);
+}
+
+static void bench_update_shift_register() {
+    static const uint8_t chain[] = {0xA5, 0x5A};
+    updateShiftRegister(chain, sizeof(chain));
+}
+
+static void bench_time_update_idle() {
+    time_update_handler();
+}
+
+static void bench_time_update_tick() {
+    sqw_edge(HIGH);
+    time_update_handler();
+    sqw_edge(LOW);
+    time_update_handler();
+}
+
+static void bench_update_display_with_time() {
+    update_display_with_time();
+}
+
+// One quick press: input_switch_sample() runs once per (simulated) ms as
+// it does from the Timer0 compare ISR, then loop() takes the events.
+static void bench_input_switch() {
+    hal_set_pin(INPUT_SWITCH, HIGH);
+    for (int i = 0; i < 100; ++i) {
+        hal_advance_millis(1);
+        input_switch_sample();
+    }
+    hal_set_pin(INPUT_SWITCH, LOW);
+    for (int i = 0; i < 100; ++i) {
+        hal_advance_millis(1);
+        input_switch_sample();
+    }
+    process_input_switch_press();
+}
+
+// The 1ms tick with a full-range ramp started every 600 ticks
+static void bench_brightness_tick() {
+    static unsigned int ticks = 0;
+    if (ticks++ % 600 == 0)
+        brightness_set(brightness_get() ? 0 : BRIGHTNESS_FULL);
+    hal_advance_millis(1);
+    brightness_tick();
+}
+
+static void bench_print() {
+    PRINT("%02d:%02d:%02d\n", 12, 34, 56);
+    log_drain();
+}
+
+static void bench_print_fixed() {
+    PRINT("Awake: %f%%, wakeups: %lu/s\n", print_fixed_point<1>(123), 1000UL);
+    log_drain();
+}
+
+// Nothing drains the ring, so after the first few calls this is the cost
+// of dropping a message
+static void bench_print_full() {
+    PRINT("%02d:%02d:%02d\n", 12, 34, 56);
+}
+
+static void bench_loop_tick() {
+    sqw_edge(HIGH);
+    loop();
+    sqw_edge(LOW);
+    loop();
+}
+
+static const benchmark benchmarks[] = {
+    {"updateShiftRegister", bench_update_shift_register, 48},
+    {"time_update_handler (idle)", bench_time_update_idle, 0},
+    {"time_update_handler (1s)", bench_time_update_tick, 2},
+    {"update_display_with_time", bench_update_display_with_time, 0},
+    {"input switch press", bench_input_switch, 2},
+    {"brightness_tick (ramp)", bench_brightness_tick, 0},
+    {"print", bench_print, 0},
+    {"print (fixed point)", bench_print_fixed, 0},
+    {"print (ring full)", bench_print_full, 0},
+    // The separator and the latch, then per 595 stage 16 clock edges and
+    // at most 8 data changes
+    {"loop (1s)", bench_loop_tick, 4 + 24 * DISPLAY_STAGES},
+};
+
+/**
+ * @brief Run one benchmark and print a line of results
+ * @return true if the benchmark stayed within its toggle budget
+ */
+static bool run_benchmark(const benchmark &b, unsigned long iterations) {
+    hal_reset_counters();
+    unsigned long rtc_reads = hal_rtc_reads();
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < iterations; ++i)
+        b.run();
+    auto stop = std::chrono::steady_clock::now();
+
+    const hal_counters &c = hal_get_counters();
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+    double writes = (double)c.writes / iterations;
+    double toggles = (double)c.toggles / iterations;
+    double serial = (double)c.serial_bytes / iterations;
+    double reads = (double)(hal_rtc_reads() - rtc_reads) / iterations;
+    bool ok = toggles <= b.toggle_budget;
+
+    fprintf(stderr, "%-28s %10.1f %8.1f %8.1f %6.1f %6.2f %8.1f  %s\n", b.name, ns, writes, toggles,
+            b.toggle_budget, reads, serial, ok ? "ok" : "FAIL");
+
+    return ok;
+}
+
+#ifndef PIO_UNIT_TESTING
+int main(int argc, char *argv[]) {
+    unsigned long iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : DEFAULT_ITERATIONS;
+    if (iterations == 0)
+        iterations = DEFAULT_ITERATIONS;
+
+    hal_reset();
+    hal_serial_mute(true);
+    setup();
+
+    fprintf(stderr, "%-28s %10s %8s %8s %6s %6s %8s\n", "benchmark", "ns/call", "writes", "toggles", "budget",
+            "i2c", "serial");
+
+    bool ok = true;
+    for (const benchmark &b : benchmarks)
+        ok = run_benchmark(b, iterations) && ok;
+
+    return ok ? 0 : 1;
+}
+#endif
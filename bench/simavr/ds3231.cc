@@ -0,0 +1,135 @@
+
+/**
+ * @brief The simulated DS3231
+ *
+ * Modeled on simavr's i2c_eeprom part: the TWI module sends start, write,
+ * read and stop messages on TWI_IRQ_OUTPUT and the part answers on
+ * TWI_IRQ_INPUT with acks and read data.
+ */
+
+#include "ds3231.h"
+
+#include <simavr/avr_twi.h>
+#include <simavr/sim_cycle_timers.h>
+#include <simavr/sim_io.h>
+
+#define SQW_HALF_PERIOD_US 500000
+
+static uint8_t bin2bcd(int value) {
+    return (value / 10) << 4 | value % 10;
+}
+
+static int bcd2bin(uint8_t value) {
+    return (value >> 4) * 10 + (value & 0x0F);
+}
+
+static void load_time(ds3231 &rtc) {
+    struct tm tm;
+    gmtime_r(&rtc.now, &tm);
+    rtc.regs[0] = bin2bcd(tm.tm_sec);
+    rtc.regs[1] = bin2bcd(tm.tm_min);
+    rtc.regs[2] = bin2bcd(tm.tm_hour);  // 24 hour mode
+    rtc.regs[3] = tm.tm_wday + 1;
+    rtc.regs[4] = bin2bcd(tm.tm_mday);
+    rtc.regs[5] = bin2bcd(tm.tm_mon + 1);
+    rtc.regs[6] = bin2bcd(tm.tm_year - 100);
+}
+
+static void store_time(ds3231 &rtc) {
+    struct tm tm = {};
+    tm.tm_sec = bcd2bin(rtc.regs[0] & 0x7F);
+    tm.tm_min = bcd2bin(rtc.regs[1] & 0x7F);
+    tm.tm_hour = bcd2bin(rtc.regs[2] & 0x3F);
+    tm.tm_mday = bcd2bin(rtc.regs[4] & 0x3F);
+    tm.tm_mon = bcd2bin(rtc.regs[5] & 0x1F) - 1;
+    tm.tm_year = bcd2bin(rtc.regs[6]) + 100;
+    rtc.now = timegm(&tm);
+}
+
+static avr_cycle_count_t sqw_edge(avr_t *avr, avr_cycle_count_t when, void *param) {
+    ds3231 &rtc = *(ds3231 *)param;
+
+    rtc.sqw_level = !rtc.sqw_level;
+    if (!rtc.sqw_level) {
+        rtc.now++;
+        load_time(rtc);
+    }
+    avr_raise_irq(rtc.sqw_pin, rtc.sqw_level);
+
+    return when + avr_usec_to_cycles(avr, SQW_HALF_PERIOD_US);
+}
+
+static void restart_sqw(ds3231 &rtc) {
+    avr_cycle_timer_cancel(rtc.avr, sqw_edge, &rtc);
+    rtc.sqw_level = false;  // The next edge (500ms on) is the rising one
+    avr_raise_irq(rtc.sqw_pin, 0);
+    avr_cycle_timer_register_usec(rtc.avr, SQW_HALF_PERIOD_US, sqw_edge, &rtc);
+}
+
+static void twi_hook(avr_irq_t *irq, uint32_t value, void *param) {
+    ds3231 &rtc = *(ds3231 *)param;
+    avr_twi_msg_irq_t msg;
+    msg.u.v = value;
+
+    if (msg.u.twi.msg & TWI_COND_STOP) {
+        if (rtc.time_written) {
+            store_time(rtc);
+            restart_sqw(rtc);
+            rtc.time_written = false;
+        }
+        rtc.selected = false;
+    }
+
+    if (msg.u.twi.msg & TWI_COND_START) {
+        rtc.selected = (msg.u.twi.addr >> 1) == DS3231_ADDRESS;
+        rtc.address_written = false;
+        if (rtc.selected)
+            avr_raise_irq(rtc.irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, msg.u.twi.addr, 1));
+    }
+
+    if (!rtc.selected)
+        return;
+
+    if (msg.u.twi.msg & TWI_COND_WRITE) {
+        avr_raise_irq(rtc.irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, msg.u.twi.addr, 1));
+        if (!rtc.address_written) {
+            rtc.pointer = msg.u.twi.data % DS3231_REGISTERS;
+            rtc.address_written = true;
+        } else {
+            if (rtc.pointer <= 6)
+                rtc.time_written = true;
+            rtc.regs[rtc.pointer] = msg.u.twi.data;
+            rtc.pointer = (rtc.pointer + 1) % DS3231_REGISTERS;
+            rtc.writes++;
+        }
+    }
+
+    if (msg.u.twi.msg & TWI_COND_READ) {
+        uint32_t data = avr_twi_irq_msg(TWI_COND_READ, msg.u.twi.addr, rtc.regs[rtc.pointer]);
+        avr_raise_irq(rtc.irq + TWI_IRQ_INPUT, data);
+        rtc.pointer = (rtc.pointer + 1) % DS3231_REGISTERS;
+        rtc.reads++;
+    }
+}
+
+/**
+ * @brief Connect a DS3231 set to 'now' (UTC) to the MCU's TWI
+ */
+void ds3231_init(ds3231 &rtc, avr_t *avr, avr_irq_t *sqw_pin, time_t now) {
+    static const char *names[] = {"=ds3231.in", "=ds3231.out"};
+
+    rtc = ds3231();
+    rtc.avr = avr;
+    rtc.sqw_pin = sqw_pin;
+    rtc.now = now;
+    load_time(rtc);
+    rtc.regs[0x0E] = 0x1C;  // Control: the power-on value
+    rtc.regs[0x11] = 25;    // Temperature MSB: 25C
+
+    rtc.irq = avr_alloc_irq(&avr->irq_pool, 0, 2, names);
+    avr_irq_register_notify(rtc.irq + TWI_IRQ_OUTPUT, twi_hook, &rtc);
+    avr_connect_irq(rtc.irq + TWI_IRQ_INPUT, avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT));
+    avr_connect_irq(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT), rtc.irq + TWI_IRQ_OUTPUT);
+
+    restart_sqw(rtc);
+}
@@ -0,0 +1,44 @@
+
+/**
+ * @brief A DS3231 on simavr's TWI, with its 1Hz square wave
+ *
+ * The registers are the chip's: BCD time and date at 0x00 - 0x06, the
+ * control and status registers and a fixed 25C temperature. Reads and
+ * writes use the register pointer as the chip does, so both RTClib's
+ * Wire code and twi_async work against it.
+ *
+ * The square wave is driven on an input pin; the time moves forward one
+ * second on each falling edge, as on the chip. Writing the time restarts
+ * the square wave, which then falls one second after the write.
+ */
+
+#ifndef DS3231_H
+#define DS3231_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_irq.h>
+
+#define DS3231_ADDRESS 0x68
+#define DS3231_REGISTERS 0x13
+
+struct ds3231 {
+    avr_t *avr;
+    avr_irq_t *irq;      // TWI_IRQ_INPUT and TWI_IRQ_OUTPUT
+    avr_irq_t *sqw_pin;  // The MCU input the square wave drives
+    uint8_t regs[DS3231_REGISTERS];
+    uint8_t pointer;
+    bool selected;
+    bool address_written;  // The first byte of a write sets the pointer
+    bool time_written;
+    bool sqw_level;
+    time_t now;
+    unsigned long reads;
+    unsigned long writes;
+};
+
+void ds3231_init(ds3231 &rtc, avr_t *avr, avr_irq_t *sqw_pin, time_t now);
+
+#endif  // DS3231_H
@@ -0,0 +1,329 @@
+
+/**
+ * @brief Cycle-accurate benchmarks of the AVR firmware under simavr
+ *
+ * Runs the real firmware image (the 'simavr' env, which is the uno build
+ * without link-time optimization so the timed functions keep their
+ * symbols) on a simulated ATmega328P at 16MHz, with a DS3231 on the TWI
+ * and its 1Hz square wave on CLOCK_1HZ. See ds3231.h.
+ *
+ * The simulation is stepped one instruction at a time. When the PC reaches
+ * the first instruction of a timed function or of an ISR (__vector_N), the
+ * cycle count and the stack pointer are noted; the call is over when the
+ * stack pointer rises above that value (ret or reti popped the return
+ * address). Times include any ISRs that ran during the call, so the min
+ * is the clean number and the max shows the worst case seen.
+ *
+ * It also tracks the longest stretch with interrupts off (the I bit in
+ * SREG clear, ISRs included) and where it started.
+ *
+ * With -v, SERIAL_CLK, SERIAL_DATA, REGISTER_CLK, SEPARATOR, the SQW and
+ * the I bit are written to a VCD file, so latch timing and interrupt-off
+ * windows can be checked in a viewer or diffed between two builds.
+ *
+ *   pio run -e simavr && pio run -e simavr_bench
+ *   .pio/build/simavr_bench/program [-s seconds] [-v trace.vcd] [-u] .pio/build/simavr/firmware.elf
+ *
+ * -u copies the firmware's serial output to stderr. The exit status is 1
+ * if the firmware crashed or a timed function never ran.
+ */
+
+#include <cxxabi.h>
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_uart.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/sim_irq.h>
+#include <simavr/sim_vcd_file.h>
+
+#include "ds3231.h"
+#include "pins.h"
+
+#define MCU "atmega328p"
+#define F_CPU 16000000
+#define DEFAULT_SECONDS 5
+#define START_TIME 1723680000  // 8/15/24 00:00:00 UTC
+
+// The functions to time, by name; every overload is timed separately
+static const char *const timed_functions[] = {
+    "updateShiftRegister", "time_update_handler", "print_format", "sched_run", "timer_2HZ_tick_ISR",
+};
+
+static const char *const vector_names[] = {
+    "RESET",       "INT0",        "INT1",         "PCINT0",     "PCINT1",      "PCINT2",     "WDT",
+    "TIMER2_COMPA", "TIMER2_COMPB", "TIMER2_OVF",  "TIMER1_CAPT", "TIMER1_COMPA", "TIMER1_COMPB", "TIMER1_OVF",
+    "TIMER0_COMPA", "TIMER0_COMPB", "TIMER0_OVF",  "SPI_STC",    "USART_RX",    "USART_UDRE", "USART_TX",
+    "ADC",         "EE_READY",    "ANALOG_COMP",  "TWI",        "SPM_READY",
+};
+
+#define VECTORS (sizeof(vector_names) / sizeof(vector_names[0]))
+
+struct symbol {
+    std::string name;
+    uint32_t address;
+    uint32_t size;
+};
+
+struct probe {
+    std::string name;
+    uint32_t address;
+    bool required;
+    unsigned long calls;
+    avr_cycle_count_t total;
+    avr_cycle_count_t min;
+    avr_cycle_count_t max;
+};
+
+struct frame {
+    size_t probe;
+    uint16_t sp;
+    avr_cycle_count_t start;
+};
+
+static std::vector<symbol> symbols;
+static std::vector<probe> probes;
+static std::vector<int> probe_at;  // Indexed by PC / 2; -1 where nothing starts
+
+static std::string demangle(const char *name) {
+    int status;
+    char *s = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    std::string result = status == 0 ? s : name;
+    free(s);
+    return result;
+}
+
+/**
+ * @brief Read the function symbols from the ELF file
+ */
+static bool read_symbols(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+
+    std::vector<uint8_t> image;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        image.insert(image.end(), buf, buf + n);
+    fclose(f);
+
+    if (image.size() < sizeof(Elf32_Ehdr) || memcmp(image.data(), ELFMAG, SELFMAG) != 0)
+        return false;
+    const Elf32_Ehdr *eh = (const Elf32_Ehdr *)image.data();
+    const Elf32_Shdr *sections = (const Elf32_Shdr *)(image.data() + eh->e_shoff);
+
+    for (int i = 0; i < eh->e_shnum; ++i) {
+        if (sections[i].sh_type != SHT_SYMTAB)
+            continue;
+        const Elf32_Sym *syms = (const Elf32_Sym *)(image.data() + sections[i].sh_offset);
+        const char *strings = (const char *)(image.data() + sections[sections[i].sh_link].sh_offset);
+        size_t count = sections[i].sh_size / sizeof(Elf32_Sym);
+        for (size_t j = 0; j < count; ++j) {
+            if (ELF32_ST_TYPE(syms[j].st_info) != STT_FUNC)
+                continue;
+            symbols.push_back({demangle(strings + syms[j].st_name), syms[j].st_value, syms[j].st_size});
+        }
+    }
+    return !symbols.empty();
+}
+
+static const char *function_at(uint32_t pc) {
+    for (const symbol &s : symbols) {
+        if (pc >= s.address && pc < s.address + s.size)
+            return s.name.c_str();
+    }
+    return "?";
+}
+
+static void add_probe(const std::string &name, uint32_t address, bool required) {
+    if (probe_at[address / 2] >= 0)
+        return;  // An alias of a function already timed
+    probe_at[address / 2] = probes.size();
+    probes.push_back({name, address, required, 0, 0, (avr_cycle_count_t)-1, 0});
+}
+
+static void find_probes(uint32_t flash_size) {
+    probe_at.assign(flash_size / 2, -1);
+
+    for (const char *name : timed_functions) {
+        size_t length = strlen(name);
+        bool found = false;
+        for (const symbol &s : symbols) {
+            if (s.name.compare(0, length, name) == 0 && (s.name[length] == '(' || s.name[length] == '\0')) {
+                add_probe(s.name, s.address, true);
+                found = true;
+            }
+        }
+        if (!found)
+            probes.push_back({std::string(name) + " (inlined or not linked)", 0, true, 0, 0, 0, 0});
+    }
+
+    for (const symbol &s : symbols) {
+        unsigned int vector;
+        if (sscanf(s.name.c_str(), "__vector_%u", &vector) == 1 && vector < VECTORS)
+            add_probe(std::string("ISR ") + vector_names[vector], s.address, false);
+    }
+}
+
+static uint16_t stack_pointer(avr_t *avr) {
+    return avr->data[R_SPL] | avr->data[R_SPH] << 8;
+}
+
+static avr_irq_t *pin_irq(avr_t *avr, uint8_t pin) {
+    char port = pin < 8 ? 'D' : (pin < 14 ? 'B' : 'C');
+    return avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(port), pin < 8 ? pin : (pin < 14 ? pin - 8 : pin - 14));
+}
+
+static void uart_out(avr_irq_t *irq, uint32_t value, void *param) {
+    fputc(value, stderr);
+}
+
+static void usage() {
+    fprintf(stderr, "usage: sim_bench [-s seconds] [-v trace.vcd] [-u] firmware.elf\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long seconds = DEFAULT_SECONDS;
+    const char *vcd_path = nullptr;
+    bool echo_uart = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:v:u")) != -1) {
+        switch (opt) {
+        case 's':
+            seconds = strtoul(optarg, nullptr, 10);
+            break;
+        case 'v':
+            vcd_path = optarg;
+            break;
+        case 'u':
+            echo_uart = true;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc - 1)
+        usage();
+    const char *elf_path = argv[optind];
+
+    elf_firmware_t firmware = {};
+    if (elf_read_firmware(elf_path, &firmware) != 0 || !read_symbols(elf_path)) {
+        fprintf(stderr, "Could not read %s\n", elf_path);
+        return 2;
+    }
+
+    avr_t *avr = avr_make_mcu_by_name(MCU);
+    if (!avr) {
+        fprintf(stderr, "simavr does not know the %s\n", MCU);
+        return 2;
+    }
+    avr_init(avr);
+    avr->frequency = F_CPU;
+    avr_load_firmware(avr, &firmware);
+    find_probes(avr->flashend + 1);
+
+    // The firmware's output goes to the hook, not simavr's own stdio echo
+    uint32_t flags = 0;
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+    if (echo_uart)
+        avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), uart_out, nullptr);
+
+    static ds3231 rtc;
+    ds3231_init(rtc, avr, pin_irq(avr, CLOCK_1HZ), START_TIME);
+
+    static const char *interrupt_names[] = {"I"};
+    avr_irq_t *interrupts = avr_alloc_irq(&avr->irq_pool, 0, 1, interrupt_names);
+
+    avr_vcd_t vcd;
+    if (vcd_path) {
+        avr_vcd_init(avr, vcd_path, &vcd, 1000);
+        avr_vcd_add_signal(&vcd, pin_irq(avr, SERIAL_CLK), 1, "SERIAL_CLK");
+        avr_vcd_add_signal(&vcd, pin_irq(avr, SERIAL_DATA), 1, "SERIAL_DATA");
+        avr_vcd_add_signal(&vcd, pin_irq(avr, REGISTER_CLK), 1, "REGISTER_CLK");
+        avr_vcd_add_signal(&vcd, pin_irq(avr, SEPARATOR), 1, "SEPARATOR");
+        avr_vcd_add_signal(&vcd, pin_irq(avr, CLOCK_1HZ), 1, "SQW");
+        avr_vcd_add_signal(&vcd, interrupts, 1, "I");
+        avr_vcd_start(&vcd);
+    }
+
+    std::vector<frame> stack;
+    avr_cycle_count_t end = (avr_cycle_count_t)seconds * F_CPU;
+    avr_cycle_count_t off_start = 0, off_max = 0;
+    uint32_t off_pc = 0, off_max_pc = 0;
+    bool enabled = false;
+    int state = cpu_Running;
+
+    while (avr->cycle < end) {
+        state = avr_run(avr);
+        if (state == cpu_Done || state == cpu_Crashed)
+            break;
+
+        uint16_t sp = stack_pointer(avr);
+        while (!stack.empty() && sp > stack.back().sp) {
+            probe &p = probes[stack.back().probe];
+            avr_cycle_count_t cycles = avr->cycle - stack.back().start;
+            p.calls++;
+            p.total += cycles;
+            if (cycles < p.min)
+                p.min = cycles;
+            if (cycles > p.max)
+                p.max = cycles;
+            stack.pop_back();
+        }
+
+        int index = avr->pc / 2 < probe_at.size() ? probe_at[avr->pc / 2] : -1;
+        if (index >= 0 && (stack.empty() || stack.back().probe != (size_t)index || stack.back().sp != sp))
+            stack.push_back({(size_t)index, sp, avr->cycle});
+
+        bool i = avr->sreg[S_I];
+        if (i != enabled) {
+            enabled = i;
+            avr_raise_irq(interrupts, i);
+            if (!i) {
+                off_start = avr->cycle;
+                off_pc = avr->pc;
+            } else if (avr->cycle - off_start > off_max) {
+                off_max = avr->cycle - off_start;
+                off_max_pc = off_pc;
+            }
+        }
+    }
+
+    if (vcd_path)
+        avr_vcd_stop(&vcd);
+
+    bool ok = state != cpu_Crashed && state != cpu_Done;
+    printf("%lu s simulated at %d MHz, %lu RTC register reads\n\n", (unsigned long)(avr->cycle / F_CPU),
+           F_CPU / 1000000, rtc.reads);
+    printf("%-44s %8s %8s %8s %8s\n", "function (cycles)", "calls", "min", "mean", "max");
+    for (const probe &p : probes) {
+        if (p.calls == 0) {
+            printf("%-44s %8s\n", p.name.c_str(), "-");
+            ok = ok && !p.required;
+            continue;
+        }
+        printf("%-44s %8lu %8llu %8llu %8llu\n", p.name.c_str(), p.calls, (unsigned long long)p.min,
+               (unsigned long long)(p.total / p.calls), (unsigned long long)p.max);
+    }
+    printf("\nLongest with interrupts off: %llu cycles, from 0x%04x in %s\n", (unsigned long long)off_max,
+           off_max_pc, function_at(off_max_pc));
+
+    if (state == cpu_Crashed)
+        fprintf(stderr, "The firmware crashed at 0x%04x\n", avr->pc);
+
+    return ok ? 0 : 1;
+}
@@ -1,33 +1,266 @@
+
 /**
- * Test the High Voltage Power Supply.
+ * @brief Test and benchmark the HV supply's fixed-point PID
+ *
+ * The step response of the fixed-point controller (src/pid.cc) is
+ * compared to a floating point copy of the PID_v1 controller it replaced,
+ * both driving the same model of the boost supply: the ADC reading moves
+ * toward PLANT_GAIN * duty with a time constant of PLANT_TAU samples. The
+ * set point, limits and gains are the firmware's, from hv_ps.h, so the
+ * samples are 10 + ADC_OVERSAMPLE_BITS bits as they are on the board. The
+ * supply starts at 0V with the set point at 455 (in 10-bit counts), then
+ * the set point steps down and back up. The test fails if the two ever
+ * differ by more than MAX_DIFFERENCE ADC counts or either one has not
+ * settled at the end of a step.
+ *
+ * Then both controllers are timed. On the AVR (pio run -e hv_ps_test -t
+ * upload, then the monitor) the time is in CPU cycles per iteration,
+ * measured with Timer1 at clk/1. On the host (pio run -e hv_ps_native &&
+ * .pio/build/hv_ps_native/program) it is ns per iteration, which is only
+ * good for comparing the two; the exit status is the test result.
+ *
+ * On the AVR the sketch then runs the real supply, as the old version of
+ * this test did, and prints its statistics every second.
  */
 
-#include "hv_ps.h"
-
 #include <Arduino.h>
 
+#ifndef __AVR__
+#include <chrono>
+#endif
+
+#include "hv_ps.h"
+#include "pid.h"
 #include "print.h"
 
 #define BAUD_RATE 115200
 
-extern double input, output;
+#define PLANT_GAIN 3.2  // 10-bit ADC counts per OCR1B count
+#define PLANT_TAU 10.0  // samples
+#define ADC_MAX (1023 * ADC_SCALE)
 
-void setup() {
-    pinMode(LED_BUILTIN, OUTPUT);
-    digitalWrite(LED_BUILTIN, HIGH);
+#define STEP_SAMPLES (24576 / SAMPLE_PERIOD)  // about 25s; the integral's time constant is about 5s
+#define STEP_SET_POINT (380 * ADC_SCALE)
+#define SETTLED (4 * ADC_SCALE)         // ADC counts from the set point; one OCR1B count is 3.2 * ADC_SCALE
+#define MAX_DIFFERENCE (4 * ADC_SCALE)  // ADC counts between the two controllers
 
-    Serial.begin(BAUD_RATE);
-    DPRINT("boot\n");
+#define ITERATIONS 1000
+
+/**
+ * @brief The PID_v1 library's Compute(), proportional on error
+ */
+struct float_pid {
+    double kp, ki, kd;
+    double setpoint;
+    double integral;
+    double last_input;
+    double output;
+
+    // The gains as hv_ps.h scales them for the fixed-point controller
+    void init(double input) {
+        kp = HV_PS_KP / ADC_SCALE;
+        ki = HV_PS_KI * HV_PS_SAMPLE_SECONDS / ADC_SCALE;
+        kd = HV_PS_KD / HV_PS_SAMPLE_SECONDS / ADC_SCALE;
+        setpoint = HV_PS_SET_POINT;
+        output = HV_PS_INITIAL_OUTPUT;
+        integral = output;
+        last_input = input;
+    }
+
+    uint16_t compute(double input) {
+        double error = setpoint - input;
+        integral += ki * error;
+        if (integral > HV_PS_OUTPUT_MAX)
+            integral = HV_PS_OUTPUT_MAX;
+        else if (integral < HV_PS_OUTPUT_MIN)
+            integral = HV_PS_OUTPUT_MIN;
+
+        output = kp * error + integral - kd * (input - last_input);
+        if (output > HV_PS_OUTPUT_MAX)
+            output = HV_PS_OUTPUT_MAX;
+        else if (output < HV_PS_OUTPUT_MIN)
+            output = HV_PS_OUTPUT_MIN;
+
+        last_input = input;
+        return output;  // hv_ps.cc truncated it for OCR1B
+    }
+};
+
+struct plant {
+    double volts;  // in 10-bit ADC counts
+
+    int16_t adc() { return volts * ADC_SCALE > ADC_MAX ? ADC_MAX : (int16_t)(volts * ADC_SCALE); }
+    void step(uint16_t duty) { volts += (PLANT_GAIN * duty - volts) / PLANT_TAU; }
+};
+
+static pid_controller fixed;
+static float_pid reference;
+
+static void init_controllers(int16_t input) {
+    pid_init(fixed, HV_PS_KP_Q16, HV_PS_KI_Q16, HV_PS_KD_Q16, HV_PS_OUTPUT_MIN, HV_PS_OUTPUT_MAX);
+    fixed.setpoint = HV_PS_SET_POINT;
+    pid_set_output(fixed, HV_PS_INITIAL_OUTPUT);
+    pid_set_automatic(fixed, true, input);
+
+    reference.init(input);
+}
+
+static bool settled(int16_t input, int16_t setpoint) {
+    return input >= setpoint - SETTLED && input <= setpoint + SETTLED;
+}
+
+/**
+ * @brief Run the step response of both controllers
+ * @return true if they match
+ */
+static bool test_step_response() {
+    plant a = {0}, b = {0};
+    init_controllers(0);
+
+    static const int16_t set_points[] = {HV_PS_SET_POINT, STEP_SET_POINT, HV_PS_SET_POINT};
+    int16_t worst = 0;
+    unsigned long worst_sample = 0;
+    bool ok = true;
+
+    for (uint8_t s = 0; s < sizeof(set_points) / sizeof(set_points[0]); ++s) {
+        fixed.setpoint = set_points[s];
+        reference.setpoint = set_points[s];
+
+        for (unsigned int i = 0; i < STEP_SAMPLES; ++i) {
+            int16_t in_a = a.adc();
+            int16_t in_b = b.adc();
+            a.step(pid_compute(fixed, in_a));
+            b.step(reference.compute(in_b));
+
+            int16_t difference = in_a > in_b ? in_a - in_b : in_b - in_a;
+            if (difference > worst) {
+                worst = difference;
+                worst_sample = s * (unsigned long)STEP_SAMPLES + i;
+            }
+        }
+
+        PRINT("Set point %d: fixed %d (out %d), float %d (out %d)\n", set_points[s], a.adc(), fixed.output,
+              b.adc(), (int)reference.output);
+        flush();
+        if (!settled(a.adc(), set_points[s]) || !settled(b.adc(), set_points[s]))
+            ok = false;
+    }
+
+    PRINT("Largest difference: %d counts at sample %lu\n", worst, worst_sample);
+    ok = ok && worst <= MAX_DIFFERENCE;
+    PRINT("Step response: %s\n", ok ? "ok" : "FAIL");
+    flush();
+    return ok;
+}
+
+#ifdef __AVR__
+
+// CPU cycles; Timer1 runs at clk/1 and a call must take less than 4ms
+static void timer_start() {
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+}
+
+#define TIME_CALL(total, call)                         \
+    do {                                               \
+        cli();                                         \
+        uint16_t start = TCNT1;                        \
+        call;                                          \
+        total += (uint16_t)(TCNT1 - start) - overhead; \
+        sei();                                         \
+    } while (0)
+
+static uint16_t overhead = 0;
+
+static void timer_calibrate() {
+    unsigned long total = 0;
+    TIME_CALL(total, asm volatile(""));
+    overhead = total;
+}
+
+#define UNITS "cycles"
+
+#else
+
+static void timer_start() {
+}
+
+static void timer_calibrate() {
+}
+
+#define TIME_CALL(total, call)                                                               \
+    do {                                                                                     \
+        auto start = std::chrono::steady_clock::now();                                       \
+        call;                                                                                \
+        auto stop = std::chrono::steady_clock::now();                                        \
+        total += std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count(); \
+    } while (0)
+
+#define UNITS "ns"
+
+#endif
+
+/**
+ * @brief Time ITERATIONS of each controller on a varying input
+ */
+static void benchmark() {
+    timer_start();
+    timer_calibrate();
+    init_controllers(HV_PS_SET_POINT);
+
+    volatile uint16_t sink = 0;
+    unsigned long fixed_total = 0;
+    unsigned long float_total = 0;
+    for (unsigned int i = 0; i < ITERATIONS; ++i) {
+        int16_t input = HV_PS_SET_POINT - 32 + (i & 63);
+        TIME_CALL(fixed_total, sink = pid_compute(fixed, input));
+        TIME_CALL(float_total, sink = reference.compute(input));
+    }
+    (void)sink;
+
+    PRINT("Fixed point: %lu " UNITS "/iteration\n", fixed_total / ITERATIONS);
+    PRINT("Floating point: %lu " UNITS "/iteration\n", float_total / ITERATIONS);
     flush();
+}
 
-    hv_ps_setup();
+static bool passed = false;
 
-    void hv_ps_adjust();
+#if HV_PS
+// The firmware's 1ms tick (src/tick.cc), which also clears the flag that
+// triggers the ADC
+ISR(TIMER0_COMPA_vect) {
+    hv_ps_tick();
+}
+#endif
+
+void setup() {
+    Serial.begin(BAUD_RATE);
+    PRINT("HV PS PID test\n");
 
-    digitalWrite(LED_BUILTIN, LOW);
+    passed = test_step_response();
+    benchmark();
+
+#if HV_PS
+    hv_ps_setup();
+    OCR0A = 0x80;
+    TIMSK0 |= _BV(OCIE0A);
+#endif
 }
 
 void loop() {
-    delay(5);
-    hv_ps_adjust();
+#if HV_PS
+    static unsigned long last_report = 0;
+    if (millis() - last_report >= 1000) {
+        last_report = millis();
+        print_hv_ps_stats();
+    }
+    log_drain();
+#endif
+}
+
+#ifndef __AVR__
+int main() {
+    setup();
+    return passed ? 0 : 1;
 }
+#endif
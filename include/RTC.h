@@ -1,15 +1,24 @@
 
 /**
  * @brief read from a DS 3231 or 1307 Real Time Clock
+ *
+ * time_update_handler() writes the digits to the display's back buffer;
+ * see display.h.
  */
 
-// The display digits
-extern volatile int digit_0;
-extern volatile int digit_1;
-extern volatile int digit_2;
-extern volatile int digit_3;
-extern volatile int digit_4;
-extern volatile int digit_5;
+#include <stdint.h>
 
 void RTC_setup();
 bool time_update_handler();
+void update_display_with_time();
+void show_date(unsigned int ms);
+uint8_t time_hour();
+
+void time_sync_ping(unsigned long token);
+void time_sync_set(uint32_t t, unsigned int delay_ms);
+void print_time_stats();
+
+#if RTC_RAW_BCD && USE_DS3231
+int16_t rtc_temperature();
+uint8_t rtc_status();
+#endif
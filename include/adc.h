@@ -0,0 +1,25 @@
+
+/**
+ * @brief Interrupt-driven ADC acquisition for the HV supply
+ *
+ * Conversions are started by the hardware on each Timer0 compare A match
+ * (the 1ms tick), so nothing waits on the ADC. The conversion-complete ISR
+ * adds ADC_OVERSAMPLES readings and decimates them to 10 +
+ * ADC_OVERSAMPLE_BITS bits, then puts the result in a ring buffer that
+ * adc_read() empties. The ripple on the HV rail is the noise that makes
+ * the extra bits real.
+ */
+
+#include <stdint.h>
+
+#ifndef ADC_OVERSAMPLE_BITS
+#define ADC_OVERSAMPLE_BITS 2  // 0 - 3; 2 gives 12-bit samples every 16ms
+#endif
+
+#define ADC_OVERSAMPLES (1 << (2 * ADC_OVERSAMPLE_BITS))  // 4 per extra bit
+#define ADC_SCALE (1 << ADC_OVERSAMPLE_BITS)  // Samples are 10-bit readings * ADC_SCALE
+
+void adc_setup(uint8_t channel);
+bool adc_read(uint16_t &value);
+
+void print_adc_stats();
@@ -0,0 +1,40 @@
+
+/**
+ * @brief Tube brightness: a gamma curve, ramps and night dimming
+ *
+ * Levels are perceptual, 0 (off) to 255 (full); a gamma table maps them to
+ * a 12-bit duty cycle for the HV_PWM_CONTROL PWM. Changes ramp over
+ * BRIGHTNESS_RAMP_MS. Between NIGHT_DIM_START and NIGHT_DIM_END (hours)
+ * the level is held to at most NIGHT_DIM_LEVEL.
+ */
+
+#include <stdint.h>
+
+#ifndef BRIGHTNESS_RAMP_MS
+#define BRIGHTNESS_RAMP_MS 0  // 0 changes the brightness at once
+#endif
+
+// Night dimming is off when the start and end hours are the same
+#ifndef NIGHT_DIM_START
+#define NIGHT_DIM_START 0
+#endif
+
+#ifndef NIGHT_DIM_END
+#define NIGHT_DIM_END 0
+#endif
+
+#ifndef NIGHT_DIM_LEVEL
+#define NIGHT_DIM_LEVEL 64
+#endif
+
+#define BRIGHTNESS_FULL 255
+#define BRIGHTNESS_POLL_MS 10000  // How often the night schedule is checked
+
+void brightness_setup();
+void brightness_set(uint8_t level);
+void brightness_restore(uint8_t level);
+uint8_t brightness_get();
+void brightness_tick();
+void brightness_poll();
+
+void print_brightness_stats();
@@ -0,0 +1,37 @@
+
+/**
+ * @brief The colon (SEPARATOR) driven by Timer1 on OC1A
+ *
+ * With COLON_TIMER1, Timer1 runs at exactly 1Hz and switches the colon in
+ * hardware, so it does not wait for loop(). Each falling SQW edge (the
+ * start of the second) restarts the timer's period, which keeps it in
+ * phase with the RTC. Without it, the time task toggles the colon on each
+ * SQW edge with fast_pin; see fast_pin.h.
+ */
+
+#ifndef COLON_H
+#define COLON_H
+
+#include <stdint.h>
+
+#ifndef COLON_TIMER1
+#define COLON_TIMER1 0  // 1 drives SEPARATOR (OC1A) from Timer1
+#endif
+
+enum colon_pattern {
+    colon_blink,  // on for the first half of each second
+    colon_flash,  // on for the first 1/8 second
+    colon_on,
+    colon_off,
+    colon_fade,  // fades up over the first half second, down over the second
+    colon_pattern_count
+};
+
+#if COLON_TIMER1
+void colon_setup();
+void colon_set_pattern(colon_pattern pattern);
+colon_pattern colon_get_pattern();
+void colon_sqw_edge(bool second);
+#endif
+
+#endif  // COLON_H
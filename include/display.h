@@ -0,0 +1,55 @@
+
+/**
+ * @brief The nixie display: a packed frame buffer sent to the 595 chain
+ *
+ * Digits are written to the back buffer with display_set_digit() and
+ * shown with display_commit(). When DISPLAY_REFRESH_HZ is not zero, a
+ * Timer2 ISR owns the shift registers: it swaps the buffers and
+ * crossfades from the old digits to the new ones over DISPLAY_FADE_MS.
+ */
+
+#include <stdint.h>
+
+#include "display_board.h"
+#include "shift_register.h"
+
+#ifndef DISPLAY_REFRESH_HZ
+#define DISPLAY_REFRESH_HZ 0  // 0 sends each frame from display_commit()
+#endif
+
+#ifndef DISPLAY_FADE_MS
+#define DISPLAY_FADE_MS 0
+#endif
+
+#ifndef DISPLAY_TUBES
+#define DISPLAY_TUBES 4
+#endif
+
+// The 595 chains of the boards; see display_board.h. Digits 0 - 5 are
+// SSMMHH, units first.
+#if DISPLAY_TUBES == 6
+typedef display_board<0x10, 0x32, 0x54> display_chain;  // HHMMSS
+#elif DISPLAY_TUBES == 4
+typedef display_board<0x32, 0x54> display_chain;  // HH:MM
+#else
+#error "DISPLAY_TUBES must be 4 or 6"
+#endif
+
+// A frame is the bytes sent to the chain, stage 0 first, and a scratch byte
+#define DISPLAY_BYTES display_chain::frame_bytes
+#define DISPLAY_STAGES display_chain::stages
+
+static_assert(DISPLAY_STAGES <= SHIFT_REGISTER_MAX_BYTES, "The 595 chain is longer than updateShiftRegister() sends");
+
+void display_setup();
+
+void display_set_digit(uint8_t n, uint8_t value);
+void display_set_pair(uint8_t pair, uint8_t bcd);
+void display_commit();
+
+uint8_t display_digit(uint8_t n);
+
+#if DISPLAY_REFRESH_HZ
+void display_refresh();
+void print_display_stats();
+#endif
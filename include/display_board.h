@@ -0,0 +1,69 @@
+
+/**
+ * @brief The 595 chain of a display board, described at compile time
+ *
+ * A board is display_board<S0, S1, ...>, one argument per 595 stage, in
+ * the order they are sent (S0 first). Each argument says which digits the
+ * stage drives: the low nibble is the digit on outputs QA-QD, the high
+ * nibble the digit on QE-QH, and DIGIT_NONE leaves that half unused.
+ * Digits are numbered as in display.h, 0 being the rightmost (the units
+ * of the seconds).
+ *
+ * From that, the templates below work out where each digit goes in the
+ * frame (its slot: stage * 2, plus 1 for the high nibble). A digit the
+ * board does not show goes to a scratch byte after the last stage, so
+ * writing a digit never needs a test.
+ */
+
+#ifndef DISPLAY_BOARD_H
+#define DISPLAY_BOARD_H
+
+#include <Arduino.h>
+
+#define DISPLAY_DIGITS 6  // HHMMSS, the most any board shows
+#define DIGIT_NONE 0x0F
+
+// The slot of digit D among the stages from Index on
+template <uint8_t D, uint8_t Index, uint8_t... Stages>
+struct digit_slot;
+
+template <uint8_t D, uint8_t Index>
+struct digit_slot<D, Index> {
+    static const uint8_t value = Index * 2;  // The scratch byte
+};
+
+template <uint8_t D, uint8_t Index, uint8_t First, uint8_t... Rest>
+struct digit_slot<D, Index, First, Rest...> {
+    static const uint8_t value = (First & 0x0F) == D ? Index * 2
+                                 : (First >> 4) == D ? Index * 2 + 1
+                                                     : digit_slot<D, Index + 1, Rest...>::value;
+};
+
+template <uint8_t P, uint8_t... Stages>
+struct pair_aligned {
+    static const uint8_t units = digit_slot<P * 2, 0, Stages...>::value;
+    static const uint8_t tens = digit_slot<P * 2 + 1, 0, Stages...>::value;
+    static const bool value = (units & 1) == 0 && (tens == units + 1 || tens == units);
+};
+
+template <uint8_t... Stages>
+struct display_board {
+    static const uint8_t stages = sizeof...(Stages);
+    static const uint8_t frame_bytes = stages + 1;  // With the scratch byte
+
+    static const uint8_t slots[DISPLAY_DIGITS];
+
+    // True if each pair of digits (seconds, minutes, hours) is one whole
+    // byte, tens in the high nibble, or is not shown; a BCD register can
+    // then be stored as is
+    static const bool pairs_aligned = pair_aligned<0, Stages...>::value && pair_aligned<1, Stages...>::value &&
+                                      pair_aligned<2, Stages...>::value;
+};
+
+template <uint8_t... Stages>
+const uint8_t display_board<Stages...>::slots[DISPLAY_DIGITS] PROGMEM = {
+    digit_slot<0, 0, Stages...>::value, digit_slot<1, 0, Stages...>::value, digit_slot<2, 0, Stages...>::value,
+    digit_slot<3, 0, Stages...>::value, digit_slot<4, 0, Stages...>::value, digit_slot<5, 0, Stages...>::value,
+};
+
+#endif  // DISPLAY_BOARD_H
@@ -0,0 +1,66 @@
+
+/**
+ * @brief Pins as types: fast_pin<N> drives Arduino pin N
+ *
+ * The port and bit are worked out at compile time from the pin number
+ * (0 - 7 PORTD, 8 - 13 PORTB, A0 - A5 PORTC), so on the AVR each call is
+ * one sbi, cbi, sbis or sbic instruction. digitalWrite() looks the port
+ * and bit up in flash tables and turns interrupts off around a
+ * read-modify-write; sbi and cbi are atomic, so these need no cli() and
+ * are safe in ISRs.
+ *
+ * Unlike digitalWrite(), these do not disconnect a timer's PWM output
+ * from the pin. pins.h checks that no pin is both a timer output and a
+ * plain pin.
+ *
+ * Off the AVR the calls go to the Arduino functions, so the native build
+ * still counts them.
+ */
+
+#ifndef FAST_PIN_H
+#define FAST_PIN_H
+
+#include <Arduino.h>
+
+template <uint8_t pin> struct fast_pin {
+    static_assert(pin < 20, "fast_pin: the ATmega328P has pins 0 - 19 (A0 - A5 are 14 - 19)");
+
+#ifdef __AVR__
+    static constexpr uint8_t mask = _BV(pin < 8 ? pin : pin < 14 ? pin - 8 : pin - 14);
+
+    static volatile uint8_t &port() { return pin < 8 ? PORTD : pin < 14 ? PORTB : PORTC; }
+    static volatile uint8_t &ddr() { return pin < 8 ? DDRD : pin < 14 ? DDRB : DDRC; }
+    static volatile uint8_t &in() { return pin < 8 ? PIND : pin < 14 ? PINB : PINC; }
+
+    static void high() { port() |= mask; }
+    static void low() { port() &= ~mask; }
+    static bool read() { return in() & mask; }
+
+    static void output() { ddr() |= mask; }
+    static void input() {
+        ddr() &= ~mask;
+        port() &= ~mask;
+    }
+    static void input_pullup() {
+        ddr() &= ~mask;
+        port() |= mask;
+    }
+#else
+    static void high() { digitalWrite(pin, HIGH); }
+    static void low() { digitalWrite(pin, LOW); }
+    static bool read() { return digitalRead(pin) == HIGH; }
+
+    static void output() { pinMode(pin, OUTPUT); }
+    static void input() { pinMode(pin, INPUT); }
+    static void input_pullup() { pinMode(pin, INPUT_PULLUP); }
+#endif
+
+    static void write(bool level) {
+        if (level)
+            high();
+        else
+            low();
+    }
+};
+
+#endif  // FAST_PIN_H
@@ -0,0 +1,44 @@
+
+/**
+ * @brief The regulated HV supply, for the boards that have one
+ *
+ * A fixed-point PID (pid.h) sets the duty cycle of a 31.25kHz PWM on
+ * HV_PS_CONTROL (Timer1, OC1B) from the supply voltage read on
+ * HV_PS_INPUT. The ADC samples on its own (adc.h) and the 1ms tick runs
+ * the controller on each new sample, so loop() does nothing.
+ */
+
+#ifndef HV_PS
+#define HV_PS 0  // 1 for boards with the PWM boost supply
+#endif
+
+#include "adc.h"
+#include "pid.h"
+
+#define SAMPLE_PERIOD ADC_OVERSAMPLES  // 1ms ticks (1.024ms each)
+
+// The controller's settings, also used by hv_ps_test/hv_ps_test.cc. The
+// input is an ADC sample (a 10-bit reading * ADC_SCALE), the output an
+// OCR1B count.
+#define HV_PS_SET_POINT (455 * ADC_SCALE)  // 0-1023 from the ADC; 455 ~ 200v
+// The timer/counter uses 9-bit resolution --> 0x0000 - 0x01FF (0 - 511)
+#define HV_PS_INITIAL_OUTPUT 0x8F  // 143, base 10, ~28% duty cycle PWM
+
+#define HV_PS_OUTPUT_MIN 10
+#define HV_PS_OUTPUT_MAX 400
+
+// PID controller constants, as they were for PID_v1 with 10-bit inputs
+#define HV_PS_KP 0.8
+#define HV_PS_KI 0.4
+#define HV_PS_KD 0.0
+#define HV_PS_SAMPLE_SECONDS (SAMPLE_PERIOD * 0.001024)
+
+// The gains for pid_init(), with the sample time and ADC_SCALE folded in
+#define HV_PS_KP_Q16 PID_Q16(HV_PS_KP / ADC_SCALE)
+#define HV_PS_KI_Q16 PID_Q16(HV_PS_KI * HV_PS_SAMPLE_SECONDS / ADC_SCALE)
+#define HV_PS_KD_Q16 PID_Q16(HV_PS_KD / HV_PS_SAMPLE_SECONDS / ADC_SCALE)
+
+void hv_ps_setup();
+void hv_ps_tick();
+
+void print_hv_ps_stats();
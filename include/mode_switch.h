@@ -1,4 +1,6 @@
 
+#include <stdint.h>
+
 #include "pins.h"
 
 void set_date_time_mode_handler();
@@ -10,8 +12,19 @@ enum switch_press_duration {
     long_5s     // 5s
 };
 
-void input_switch_push();
-void input_switch_release();
+enum switch_event_type {
+    switch_pressed,
+    switch_held,     // still down after 2s or 5s; see duration
+    switch_released  // duration is how long it was down
+};
+
+struct switch_event {
+    uint8_t type;      // switch_event_type
+    uint8_t duration;  // switch_press_duration
+    unsigned long time_ms;  // now_ms() when it happened
+};
+
+void input_switch_setup();
+void input_switch_sample();
 
-bool poll_input_button();
-void process_input_switch_press();
+bool process_input_switch_press();
@@ -0,0 +1,40 @@
+
+/**
+ * @brief A fixed-point PID controller
+ *
+ * The same controller as the PID_v1 library the HV supply used to run
+ * (derivative on the measurement, the integral clamped to the output
+ * limits), without floating point. The input and output are integer
+ * counts (ADC and OCR values); the gains and the integral are Q16.16.
+ * The sample time is folded into the gains, so pid_compute() must be
+ * called once per sample period.
+ */
+
+#ifndef PID_H
+#define PID_H
+
+#include <stdint.h>
+
+// A gain as Q16.16; use with constants so no floating point is left in
+// the program
+#define PID_Q16(x) ((int32_t)((x) * 65536.0 + ((x) < 0 ? -0.5 : 0.5)))
+
+struct pid_controller {
+    int32_t kp;        // Q16.16, per count of error
+    int32_t ki;        // Q16.16, ki * the sample time in seconds
+    int32_t kd;        // Q16.16, kd / the sample time in seconds
+    int32_t integral;  // Q16.16, in output counts
+    int16_t setpoint;
+    int16_t last_input;
+    int16_t output;
+    int16_t out_min;
+    int16_t out_max;
+    bool automatic;
+};
+
+void pid_init(pid_controller &pid, int32_t kp, int32_t ki, int32_t kd, int16_t out_min, int16_t out_max);
+void pid_set_output(pid_controller &pid, int16_t output);
+void pid_set_automatic(pid_controller &pid, bool automatic, int16_t input);
+int16_t pid_compute(pid_controller &pid, int16_t input);
+
+#endif  // PID_H
@@ -14,9 +14,28 @@
 // Choose pins that cannot be used for hardware PWM for all except the
 // PWM brightness control.
 
+// How the shift register chain is driven. SHIFT_OUT_BITBANG works with
+// any pins. SHIFT_OUT_SPI uses the hardware SPI port, so SERIAL_DATA must
+// be MOSI (11) and SERIAL_CLK must be SCK (13, which is also LED_BUILTIN;
+// the LED will flicker with the clock). Pin 10 (SS) is made an output so
+// the SPI port stays in master mode. Set SHIFT_REGISTER_TRANSPORT in
+// platformio.ini for boards wired to the SPI pins.
+#define SHIFT_OUT_BITBANG 0
+#define SHIFT_OUT_SPI 1
+
+#ifndef SHIFT_REGISTER_TRANSPORT
+#define SHIFT_REGISTER_TRANSPORT SHIFT_OUT_BITBANG
+#endif
+
+#if SHIFT_REGISTER_TRANSPORT == SHIFT_OUT_SPI
+#define SERIAL_CLK 13  // SCK to SHCP
+#define SERIAL_DATA 11  // MOSI to DS
+#else
 #define SERIAL_CLK 4  // SERCLK (shift register clock) input. aka SHCP
-#define REGISTER_CLK 7  // RDCLK (register clock/latch) input. aka STCP
 #define SERIAL_DATA 8   // SER (serial data) input. aka DS
+#endif
+
+#define REGISTER_CLK 7  // RDCLK (register clock/latch) input. aka STCP
 
 // Other pins on the 74595 shift register chip:
 // OE (Output Enable) and SRCLR (Shift Register Clear)
@@ -26,6 +45,64 @@
 // PWM brightness 980Hz on pins 5 and 6, otherwise 480Hz
 #define HV_PWM_CONTROL 5
 
+// The regulated HV supply (HV_PS): the boost converter's PWM on OC1B and
+// the divided-down supply voltage. Pin 10 is also SPI's SS, which only
+// needs to be an output.
+#define HV_PS_CONTROL 10
+#define HV_PS_INPUT A0
+
 // The flashing colon, flashes once per second. SEPARATOR can be
-// any pin between 8 and 13 inclusive (PORT B)
+// any pin between 8 and 13 inclusive (PORT B), but COLON_TIMER1 needs
+// OC1A (9); see colon.h
 #define SEPARATOR 9
+
+// The ATmega328P's timer output and external interrupt pins
+#define PIN_OC0A 6
+#define PIN_OC0B 5
+#define PIN_OC1A 9
+#define PIN_OC1B 10
+#define PIN_OC2A 11
+#define PIN_OC2B 3
+#define PIN_INT0 2
+#define PIN_INT1 3
+
+// Checks. fast_pin<> writes the port without disconnecting a timer, so a
+// timer output must not also be a plain pin; with each pin used once,
+// that only needs the timer outputs to be on the right pins.
+
+// attachInterrupt() needs INT0 or INT1
+#if CLOCK_1HZ != PIN_INT0 && CLOCK_1HZ != PIN_INT1
+#error "CLOCK_1HZ must be INT0 (2) or INT1 (3)"
+#endif
+
+// brightness.cc drives OC0B (Timer0 PWM)
+#if HV_PWM_CONTROL != PIN_OC0B
+#error "HV_PWM_CONTROL must be OC0B (5)"
+#endif
+
+#if COLON_TIMER1 && SEPARATOR != PIN_OC1A
+#error "COLON_TIMER1 drives OC1A; SEPARATOR must be pin 9"
+#endif
+
+#if HV_PS && HV_PS_CONTROL != PIN_OC1B
+#error "HV_PS drives OC1B; HV_PS_CONTROL must be pin 10"
+#endif
+
+// With no pin used twice, the sum of the pin bits has no carries, so it
+// equals their OR. Pins 0 and 1 are the serial port.
+#define PIN_BIT(p) (1ULL << (p))
+
+#if HV_PS
+#define HV_PS_PIN_BIT PIN_BIT(HV_PS_CONTROL)
+#else
+#define HV_PS_PIN_BIT 0
+#endif
+
+#define PIN_BITS(op)                                                                                   \
+    (PIN_BIT(0) op PIN_BIT(1) op PIN_BIT(CLOCK_1HZ) op PIN_BIT(INPUT_SWITCH) op PIN_BIT(SERIAL_CLK) op \
+     PIN_BIT(SERIAL_DATA) op PIN_BIT(REGISTER_CLK) op PIN_BIT(HV_PWM_CONTROL) op PIN_BIT(SEPARATOR) op \
+     HV_PS_PIN_BIT)
+
+#if PIN_BITS(+) != PIN_BITS(|)
+#error "pins.h: a pin is used twice, or pin 0 or 1 (the serial port) is used"
+#endif
@@ -0,0 +1,25 @@
+
+/**
+ * @brief Idle sleep between interrupts and shutting down unused peripherals
+ *
+ * power_idle() is called at the end of loop(). It puts the CPU in idle
+ * sleep until the next interrupt unless a task is due. Idle is the
+ * only sleep mode that keeps Timer0 (millis() and the HV_PWM_CONTROL PWM)
+ * running; the SQW and switch interrupts (INT0/INT1) wake it, as do the
+ * Timer0 overflow and the display refresh.
+ */
+
+#ifndef POWER_SAVE
+#define POWER_SAVE 0  // 0 never sleeps
+#endif
+
+#ifndef POWER_STATS
+#define POWER_STATS 0  // seconds between awake/asleep reports, 0 for none
+#endif
+
+void power_setup();
+void power_idle();
+
+#if POWER_STATS
+void print_power_stats();
+#endif
@@ -3,22 +3,184 @@
  * A version of printf for the Arduino.
  * 11/20/22
  * James Gallagher <jhrg@mac.com>
+ *
+ * PRINT("fmt", args...) checks the format against the arguments' types at
+ * compile time, keeps the format in flash and formats straight into the
+ * log ring; see print.cc. The conversions are a subset of printf's:
+ *
+ *   %d %u %x   int or narrower; %ld %lu %lx for 32 bits
+ *   %c         a character
+ *   %s %S      a string in RAM, a string in flash (PSTR(), F())
+ *   %f         a print_fixed_point<places>(n) number: print_fixed_point<2>(1234)
+ *              prints 12.34
+ *   %%         a percent sign
+ *
+ * Each may have the '-' (left-justify) or '0' flag and a width.
  */
 
-void print(const char *fmt, ...);
-void print(const __FlashStringHelper *fmt, ...);
+#ifndef PRINT_H
+#define PRINT_H
 
-// Print using %02d
-// TODO needs work
-//#define frac(f) (int)((f > 0.0) ? (int(f*100)%100) : round((f+ceil(f))*100.0))
-#define frac(f) (int(f * 100) % 100)
+#include <stdint.h>
+
+class __FlashStringHelper;
+
+/**
+ * @brief A fixed-point number for %f: 'value' has 'places' decimal places
+ */
+template <uint8_t places> struct print_fixed {
+    long value;
+};
+
+template <uint8_t places> print_fixed<places> print_fixed_point(long value) {
+    return {value};
+}
+
+/**
+ * @brief One argument, as print_format() reads it
+ */
+struct print_arg {
+    union {
+        long n;
+        const char *s;
+    };
+    uint8_t places;  // Of a print_fixed_point<>() number
+
+    template <typename T> print_arg(T n) : n(n), places(0) {}
+    print_arg(const char *s) : s(s), places(0) {}
+    print_arg(char *s) : s(s), places(0) {}
+    print_arg(const __FlashStringHelper *s) : s((const char *)s), places(0) {}
+    template <uint8_t p> print_arg(print_fixed<p> f) : n(f.value), places(p) {}
+};
+
+void print_format(const char *fmt, const print_arg *args);
+
+template <typename... A> void print_P(const __FlashStringHelper *fmt, A... args) {
+    const print_arg a[] = {args...};
+    print_format((const char *)fmt, a);
+}
+
+inline void print_P(const __FlashStringHelper *fmt) {
+    print_format((const char *)fmt, nullptr);
+}
+
+/**
+ * The compile-time format check. Plain conversions take int or narrower
+ * and 'l' ones take 32 bits; a type narrower than int may go with either
+ * sign, as printf's promotions allow. On the host, where int is 32 bits,
+ * this is looser.
+ */
+namespace print_check {
+
+enum kind { other, integer, string, flash_string, fixed_point };
+
+template <typename T> struct type {
+    static constexpr kind k = __is_enum(T) ? integer : other;
+    static constexpr bool is_signed = true;
+};
+
+template <typename T, bool s> struct integer_type {
+    static constexpr kind k = integer;
+    static constexpr bool is_signed = s;
+};
+
+template <> struct type<bool> : integer_type<bool, false> {};
+template <> struct type<char> : integer_type<char, ((char)-1 < 0)> {};
+template <> struct type<signed char> : integer_type<signed char, true> {};
+template <> struct type<unsigned char> : integer_type<unsigned char, false> {};
+template <> struct type<short> : integer_type<short, true> {};
+template <> struct type<unsigned short> : integer_type<unsigned short, false> {};
+template <> struct type<int> : integer_type<int, true> {};
+template <> struct type<unsigned int> : integer_type<unsigned int, false> {};
+template <> struct type<long> : integer_type<long, true> {};
+template <> struct type<unsigned long> : integer_type<unsigned long, false> {};
+
+template <> struct type<const char *> {
+    static constexpr kind k = string;
+    static constexpr bool is_signed = false;
+};
+
+template <> struct type<char *> : type<const char *> {};
+
+template <> struct type<const __FlashStringHelper *> {
+    static constexpr kind k = flash_string;
+    static constexpr bool is_signed = false;
+};
+
+template <uint8_t p> struct type<print_fixed<p>> {
+    static constexpr kind k = fixed_point;
+    static constexpr bool is_signed = true;
+};
+
+template <typename T> constexpr bool fits_int(bool is_signed) {
+    return sizeof(T) <= sizeof(int) && (sizeof(T) < sizeof(int) || type<T>::is_signed == is_signed);
+}
+
+template <typename T> constexpr bool fits_long(bool is_signed) {
+    return sizeof(T) >= 4 && sizeof(T) <= sizeof(long) && type<T>::is_signed == is_signed;
+}
+
+template <typename T> constexpr bool integer_matches(char conversion, bool is_long) {
+    return conversion == 'd' ? (is_long ? fits_long<T>(true) : fits_int<T>(true))
+           : conversion == 'u' || conversion == 'x' ? (is_long ? fits_long<T>(false) : fits_int<T>(false))
+           : conversion == 'c' && !is_long && sizeof(T) <= sizeof(int);
+}
+
+template <typename T> constexpr bool matches(char conversion, bool is_long) {
+    return type<T>::k == integer        ? integer_matches<T>(conversion, is_long)
+           : type<T>::k == string       ? !is_long && conversion == 's'
+           : type<T>::k == flash_string ? !is_long && conversion == 'S'
+           : type<T>::k == fixed_point  ? !is_long && conversion == 'f'
+                                        : false;
+}
+
+// Past the flags and the width
+constexpr const char *conversion(const char *f) {
+    return *f == '-' || (*f >= '0' && *f <= '9') ? conversion(f + 1) : f;
+}
+
+template <typename... A> struct list {};
+
+template <typename... A> list<A...> types(A...);
+
+template <typename L> struct format;
+
+template <> struct format<list<>> {
+    static constexpr bool ok(const char *f) {
+        return *f == '\0' ? true : *f != '%' ? ok(f + 1) : f[1] == '%' ? ok(f + 2) : false;
+    }
+};
+
+template <typename T, typename... R> struct format<list<T, R...>> {
+    static constexpr bool ok(const char *f) {
+        return *f == '\0' ? false : *f != '%' ? ok(f + 1) : f[1] == '%' ? ok(f + 2) : argument(conversion(f + 1));
+    }
+
+    static constexpr bool argument(const char *c) {
+        return *c == 'l' ? matches<T>(c[1], true) && format<list<R...>>::ok(c + 2)
+                         : matches<T>(*c, false) && format<list<R...>>::ok(c + 1);
+    }
+};
+
+}  // namespace print_check
+
+#define PRINT(fmt, ...)                                                                        \
+    do {                                                                                       \
+        static_assert(print_check::format<decltype(print_check::types(__VA_ARGS__))>::ok(fmt), \
+                      "PRINT: the format does not match the arguments");                      \
+        print_P(F(fmt), ##__VA_ARGS__);                                                        \
+    } while (0)
 
 void flush();
 
+void log_drain();
+bool log_pending();
+void print_log_stats();
+
 // Using F() in this macro reduced RAM use from 67% to 50% in ~1200 LOC
 #if DEBUG
-#define DPRINTV(fmt, ...) print(F(fmt), __VA_ARGS__)
-#define DPRINT(fmt) print(F(fmt))
+#define DPRINTV(fmt, ...) PRINT(fmt, __VA_ARGS__)
+#define DPRINT(fmt) PRINT(fmt)
 #define DPRINTF(fmt, f) Serial.print(fmt); Serial.println(f)
 #else
 #define DPRINTV(fmt, ...)
@@ -26,3 +188,5 @@ void flush();
 
 #define DPRINTF(fmt, f)
 #endif
+
+#endif  // PRINT_H
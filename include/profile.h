@@ -0,0 +1,79 @@
+
+/**
+ * @brief A profiler for loop() and the ISRs, read over the serial port
+ *
+ * PROFILE_SCOPE(probe) at the top of a block times the block with Timer1
+ * and adds the time to the probe's statistics when the block exits (early
+ * returns included). With PROFILE=0 the probes compile to nothing.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+#ifndef PROFILE
+#define PROFILE 0
+#endif
+
+enum profile_probe {
+    probe_loop,               // one pass of loop(), less the sleep
+    probe_time_update,        // time_update_handler()
+    probe_shift_register,     // updateShiftRegister()
+    probe_sqw_isr,            // timer_2HZ_tick_ISR()
+    probe_switch_isr,         // input_switch_sample(), in the 1ms tick ISR
+    probe_display_latency,    // compare match to display ISR entry
+    probe_count
+};
+
+#if PROFILE
+
+#ifndef __AVR__
+#error "The profiler needs Timer1; use PROFILE=0"
+#endif
+
+#if COLON_TIMER1 || HV_PS
+#error "The profiler, the Timer1 colon and the HV supply all use Timer1; use PROFILE=0"
+#endif
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#define PROFILE_PRESCALE 8  // Timer1 ticks are 8 cycles; the longest time is 32ms
+
+void profile_setup();
+void profile_record(profile_probe probe, uint16_t ticks);
+void profile_dump();
+
+/**
+ * @brief Read TCNT1; an ISR that reads it between the two bytes would
+ * change the high byte in TEMP
+ */
+inline uint16_t profile_ticks() {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t ticks = TCNT1;
+    SREG = sreg;
+    return ticks;
+}
+
+class profile_timer {
+    profile_probe probe;
+    uint16_t start;
+
+public:
+    profile_timer(profile_probe p) : probe(p), start(profile_ticks()) {}
+    ~profile_timer() { profile_record(probe, profile_ticks() - start); }
+};
+
+#define PROFILE_SCOPE(probe) profile_timer profile_scope_timer(probe)
+#define PROFILE_RECORD(probe, ticks) profile_record(probe, ticks)
+
+#else
+
+#define PROFILE_SCOPE(probe)
+#define PROFILE_RECORD(probe, ticks)
+
+#endif
+
+#endif  // PROFILE_H
@@ -0,0 +1,23 @@
+
+/**
+ * @brief RAM use: the stack high-water mark, free RAM and the static
+ * footprint
+ *
+ * With RAM_CHECK set, the free RAM is painted before main() runs. The
+ * stack high-water mark is the lowest painted byte that has been written.
+ * ram_poll() checks the headroom now and then and sets ram_low when it
+ * falls below RAM_WARN_BYTES.
+ */
+
+#ifndef RAM_CHECK
+#define RAM_CHECK 0
+#endif
+
+#if RAM_CHECK
+#define RAM_CHECK_INTERVAL 10000  // ms between ram_poll() checks
+
+extern volatile bool ram_low;
+
+void ram_poll();
+void print_ram_stats();
+#endif
@@ -0,0 +1,28 @@
+
+/**
+ * @brief Why the MCU reset: a cold power-on or a warm reset
+ *
+ * MCUSR is read and cleared from .init3, before anything else runs. The
+ * bootloader may already have cleared it, so a word in .noinit is checked
+ * too: it only holds RESET_MAGIC if the RAM kept its contents, which it
+ * does through a brownout, watchdog or external reset but not a power
+ * cycle.
+ */
+
+#ifndef RESET_H
+#define RESET_H
+
+#include <stdint.h>
+
+// The MCUSR bits
+enum reset_cause {
+    reset_power_on = 0x01,
+    reset_external = 0x02,
+    reset_brownout = 0x04,
+    reset_watchdog = 0x08,
+};
+
+uint8_t reset_flags();
+bool reset_cold();
+
+#endif  // RESET_H
@@ -0,0 +1,42 @@
+
+/**
+ * @brief A cooperative scheduler for the work loop() does
+ *
+ * Each task is a function that runs to completion. A task runs when its
+ * deadline comes (sched_at(), or every 'period' ms) or when an ISR posts
+ * it (sched_post()). The tasks that are waiting are kept in a queue
+ * ordered by deadline, so a pass of loop() looks at the head of the
+ * queue and a bit mask, however many tasks there are.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+enum task_id {
+    task_time,        // time_update_handler(): SQW edges, RTC reads, time sync
+    task_switch,      // process_input_switch_press()
+    task_serial,      // serial_cmd_poll()
+    task_log,         // log_drain()
+    task_brightness,  // brightness_poll(): night dimming
+    task_ram,         // ram_poll()
+    task_settings,    // settings_task(): EEPROM writes
+    task_count
+};
+
+#define SCHED_NAME_MAX 12
+
+typedef void (*task_function)();
+
+void sched_add(task_id id, task_function run, unsigned int period_ms);
+void sched_post(task_id id);
+void sched_at(task_id id, unsigned long when_ms);
+void sched_run();
+bool sched_ready();
+uint8_t sched_running();
+void sched_task_name(uint8_t id, char *name);  // name must hold SCHED_NAME_MAX
+
+void print_sched_stats();
+
+#endif  // SCHEDULER_H
@@ -0,0 +1,7 @@
+
+/**
+ * @brief One-letter commands read from the serial port; '?' lists them.
+ * 'T' and 'S' take numbers and end with a newline
+ */
+
+void serial_cmd_poll();
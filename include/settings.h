@@ -0,0 +1,46 @@
+
+/**
+ * @brief Settings kept in EEPROM across resets
+ *
+ * The settings are kept in a log of SETTINGS_SLOTS records in EEPROM, each
+ * with a sequence number and a CRC. A change is written to the slot after
+ * the newest, so each cell is written once every SETTINGS_SLOTS changes.
+ * At boot the newest record with a good CRC is used. A record that was
+ * being written when the power failed has a bad CRC, so the one before it
+ * is used.
+ *
+ * settings_save() only copies the settings; the settings task writes them
+ * SETTINGS_WRITE_DELAY_MS later (so a run of switch presses is one write),
+ * a byte at a time while the EEPROM is not busy. settings_save_now()
+ * writes them before it returns, up to 60ms.
+ */
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdint.h>
+
+#ifndef SETTINGS_EEPROM
+#define SETTINGS_EEPROM 0  // 0 keeps the settings in RAM only
+#endif
+
+#define SETTINGS_SLOTS 60  // 60 x 17 bytes of the 1024
+#define SETTINGS_WRITE_DELAY_MS 5000
+
+struct settings {
+    uint8_t brightness;      // The switch's brightness step; see mode_switch.cc
+    uint8_t colon;           // colon_pattern
+    uint32_t sync_time;      // The time of the last time sync, 0 for none
+    int32_t sync_offset_ms;  // How far ahead the clock was then
+    uint8_t resets[4];       // Resets by cause: power-on, external, brownout, watchdog; see reset.h
+};
+
+void settings_setup();
+const settings &settings_get();
+void settings_save(const settings &s);
+void settings_save_now(const settings &s);
+void settings_task();
+
+void print_settings_stats();
+
+#endif  // SETTINGS_H
@@ -0,0 +1,16 @@
+
+/**
+ * @brief Move data to the 74HC595 shift register chain
+ *
+ * The transport (bit-banged or the hardware SPI port) is chosen with
+ * SHIFT_REGISTER_TRANSPORT; see pins.h.
+ */
+
+#include <stdint.h>
+
+// The longest chain updateShiftRegister() will send in one call
+#define SHIFT_REGISTER_MAX_BYTES 4
+
+void shift_register_setup();
+void updateShiftRegister(const uint8_t *data, uint8_t n);
+bool shift_register_busy();
@@ -0,0 +1,10 @@
+
+/**
+ * @brief The 1ms tick: the Timer0 compare A interrupt
+ *
+ * Timer0 runs millis() from its overflow interrupt; the compare A match
+ * comes once per overflow (every 1.024ms) and is free. Its ISR samples the
+ * switch, runs the brightness PWM and paces the HV supply's samples.
+ */
+
+void tick_setup();
@@ -0,0 +1,21 @@
+
+/**
+ * @brief A millisecond timebase disciplined by the RTC's 1Hz square wave
+ *
+ * Each falling SQW edge is one RTC second. The MCU's micros() between
+ * edges gives the length of that second on the MCU's resonator; a filtered
+ * value of it is used to interpolate between edges. now_ms() counts in RTC
+ * time, so it does not drift the way millis() does, and it never goes
+ * back. The brightness ramps and the switch event stamps use it.
+ */
+
+#include <stdint.h>
+
+void timebase_edge();
+void timebase_restart();
+
+uint32_t now_ms();
+uint32_t timebase_seconds();
+long timebase_ppm();
+
+void print_timebase_stats();
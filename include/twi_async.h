@@ -0,0 +1,38 @@
+
+/**
+ * @brief A non-blocking TWI (I2C) master for register reads and writes
+ *
+ * Start a transfer, then call twi_poll() from loop(); it returns the
+ * status and calls the completion function when the transfer ends. A
+ * transfer that takes longer than TWI_TIMEOUT_MS is abandoned and the bus
+ * is recovered (SCL clocked until the slave lets go of SDA).
+ */
+
+#include <stdint.h>
+
+#define TWI_TIMEOUT_MS 10
+#define TWI_MAX_TRANSFER 20
+
+enum twi_status {
+    twi_idle,
+    twi_busy,
+    twi_done,     // the transfer finished
+    twi_nack,     // the slave did not acknowledge
+    twi_error,    // bus error or lost arbitration
+    twi_timeout   // the transfer did not finish; the bus was recovered
+};
+
+typedef void (*twi_callback)(twi_status status);
+
+void twi_setup();
+
+bool twi_start_read(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t n, twi_callback done = 0);
+bool twi_start_write(uint8_t addr, uint8_t reg, const uint8_t *buf, uint8_t n, twi_callback done = 0);
+
+twi_status twi_poll();
+twi_status twi_wait();
+bool twi_in_progress();
+
+bool twi_bus_recover();
+
+void print_twi_stats();
@@ -0,0 +1,34 @@
+
+/**
+ * @brief Local time from UTC with a table of the zone's offset changes
+ *
+ * With RTC_UTC, the RTC keeps UTC and tools/time_sync.py sets it to UTC.
+ * tz_table.cc, made by tools/tz_table.py, lists the times the zone's UTC
+ * offset changes. tz_offset() looks up the offset in effect and says how
+ * long it lasts, so the caller only asks again after that.
+ */
+
+#ifndef TZ_H
+#define TZ_H
+
+#include <stdint.h>
+
+#ifndef RTC_UTC
+#define RTC_UTC 0  // 0: the RTC keeps local time and there is no table
+#endif
+
+struct tz_transition {
+    uint32_t utc;        // Seconds since 1970
+    int16_t offset_min;  // The UTC offset from then on
+};
+
+#if RTC_UTC
+extern const char tz_name[];
+extern const tz_transition tz_transitions[];
+extern const uint16_t tz_transition_count;
+
+int16_t tz_offset(uint32_t utc, uint32_t &until);
+void print_tz_stats();
+#endif
+
+#endif  // TZ_H
@@ -0,0 +1,27 @@
+
+/**
+ * @brief A watchdog for hangs in loop() and in the ISRs
+ *
+ * loop() feeds the watchdog on each pass. If a pass takes longer than
+ * WATCHDOG_TIMEOUT, the watchdog interrupt saves a post-mortem record in
+ * .noinit RAM and then resets the MCU. After the reset, watchdog_setup()
+ * reports the record over serial and counts the reset; the counts of each
+ * reset cause are kept with the settings.
+ */
+
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <stdint.h>
+
+#ifndef WATCHDOG
+#define WATCHDOG 0
+#endif
+
+#if WATCHDOG
+void watchdog_setup();
+void watchdog_feed(uint16_t loop_us);
+void print_watchdog_stats();
+#endif
+
+#endif  // WATCHDOG_H
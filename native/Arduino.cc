@@ -0,0 +1,331 @@
+
+/**
+ * @brief Host implementation of the Arduino calls in native/Arduino.h
+ *
+ * Pins are an array of levels and modes, time is a counter that only
+ * moves when the bench or a test moves it (delay() advances it too) and
+ * the interrupt 'vector' is the table filled by attachInterrupt().
+ */
+
+#include <Arduino.h>
+
+#include "native_hal.h"
+
+HardwareSerial Serial;
+
+static uint8_t pin_level[NUM_DIGITAL_PINS];
+static uint8_t pin_mode[NUM_DIGITAL_PINS];
+static int analog_value[NUM_DIGITAL_PINS];
+
+static void (*isr_table[2])() = {nullptr, nullptr};
+static int isr_mode[2] = {0, 0};
+
+static unsigned long now_us = 0;
+
+static void (*toggle_hook)(uint8_t pin, uint8_t level) = nullptr;
+
+static bool serial_muted = false;
+static const char *serial_input = nullptr;
+static char serial_output[HAL_SERIAL_CAPTURE];
+static size_t serial_output_length = 0;
+
+static hal_counters counters;
+
+void hal_reset_counters() {
+    memset(&counters, 0, sizeof(counters));
+}
+
+void hal_reset() {
+    memset(pin_level, 0, sizeof(pin_level));
+    memset(pin_mode, 0, sizeof(pin_mode));
+    memset(analog_value, 0, sizeof(analog_value));
+    isr_table[0] = isr_table[1] = nullptr;
+    isr_mode[0] = isr_mode[1] = 0;
+    toggle_hook = nullptr;
+    now_us = 0;
+    serial_input = nullptr;
+    hal_serial_clear();
+    hal_reset_counters();
+}
+
+const hal_counters &hal_get_counters() {
+    return counters;
+}
+
+int hal_pin_level(uint8_t pin) {
+    return pin < NUM_DIGITAL_PINS ? pin_level[pin] : -1;
+}
+
+int hal_pin_mode(uint8_t pin) {
+    return pin < NUM_DIGITAL_PINS ? pin_mode[pin] : -1;
+}
+
+int hal_analog_value(uint8_t pin) {
+    return pin < NUM_DIGITAL_PINS ? analog_value[pin] : -1;
+}
+
+void hal_set_pin(uint8_t pin, int level) {
+    if (pin < NUM_DIGITAL_PINS)
+        pin_level[pin] = level ? HIGH : LOW;
+}
+
+void hal_fire_pin(uint8_t pin, int level) {
+    if (pin >= NUM_DIGITAL_PINS)
+        return;
+
+    uint8_t old_level = pin_level[pin];
+    pin_level[pin] = level ? HIGH : LOW;
+
+    int n = digitalPinToInterrupt(pin);
+    if (n == NOT_AN_INTERRUPT || !isr_table[n] || old_level == pin_level[pin])
+        return;
+
+    bool rising = pin_level[pin] == HIGH;
+    if (isr_mode[n] == CHANGE || (isr_mode[n] == RISING && rising) || (isr_mode[n] == FALLING && !rising))
+        isr_table[n]();
+}
+
+void hal_set_analog_input(uint8_t pin, int value) {
+    if (pin < NUM_DIGITAL_PINS)
+        analog_value[pin] = value;
+}
+
+void hal_on_toggle(void (*hook)(uint8_t pin, uint8_t level)) {
+    toggle_hook = hook;
+}
+
+void hal_set_millis(unsigned long ms) {
+    now_us = ms * 1000UL;
+}
+
+void hal_advance_millis(unsigned long ms) {
+    now_us += ms * 1000UL;
+}
+
+void hal_serial_mute(bool mute) {
+    serial_muted = mute;
+}
+
+void hal_serial_input(const char *text) {
+    serial_input = text;
+}
+
+const char *hal_serial_output() {
+    return serial_output;
+}
+
+void hal_serial_clear() {
+    serial_output_length = 0;
+    serial_output[0] = '\0';
+}
+
+// Arduino API
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin < NUM_DIGITAL_PINS)
+        pin_mode[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    if (pin >= NUM_DIGITAL_PINS)
+        return;
+
+    counters.writes++;
+    uint8_t level = val ? HIGH : LOW;
+    if (pin_level[pin] != level) {
+        counters.toggles++;
+        counters.pin_toggles[pin]++;
+        pin_level[pin] = level;
+        if (toggle_hook)
+            toggle_hook(pin, level);
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < NUM_DIGITAL_PINS ? pin_level[pin] : LOW;
+}
+
+void analogWrite(uint8_t pin, int val) {
+    counters.analog_writes++;
+    if (pin < NUM_DIGITAL_PINS)
+        analog_value[pin] = val;
+}
+
+int analogRead(uint8_t pin) {
+    return pin < NUM_DIGITAL_PINS ? analog_value[pin] : 0;
+}
+
+// Same pin sequence as the AVR core's shiftOut()
+void shiftOut(uint8_t data_pin, uint8_t clock_pin, uint8_t bit_order, uint8_t val) {
+    counters.shift_outs++;
+    for (uint8_t i = 0; i < 8; i++) {
+        if (bit_order == LSBFIRST)
+            digitalWrite(data_pin, !!(val & (1 << i)));
+        else
+            digitalWrite(data_pin, !!(val & (1 << (7 - i))));
+
+        digitalWrite(clock_pin, HIGH);
+        digitalWrite(clock_pin, LOW);
+    }
+}
+
+unsigned long millis() {
+    return now_us / 1000UL;
+}
+
+unsigned long micros() {
+    return now_us;
+}
+
+void delay(unsigned long ms) {
+    now_us += ms * 1000UL;
+}
+
+void delayMicroseconds(unsigned int us) {
+    now_us += us;
+}
+
+long random(long howbig) {
+    return howbig == 0 ? 0 : rand() % howbig;
+}
+
+long random(long howsmall, long howbig) {
+    return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+    srand(seed);
+}
+
+void attachInterrupt(uint8_t interrupt_num, void (*user_func)(), int mode) {
+    if (interrupt_num < 2) {
+        isr_table[interrupt_num] = user_func;
+        isr_mode[interrupt_num] = mode;
+    }
+}
+
+void detachInterrupt(uint8_t interrupt_num) {
+    if (interrupt_num < 2)
+        isr_table[interrupt_num] = nullptr;
+}
+
+volatile uint8_t SREG = 0;
+
+void cli() {
+    counters.cli_calls++;
+}
+
+void sei() {
+}
+
+// HardwareSerial
+
+void HardwareSerial::begin(unsigned long) {
+}
+
+int HardwareSerial::available() {
+    return serial_input ? strlen(serial_input) : 0;
+}
+
+int HardwareSerial::read() {
+    if (!serial_input || !*serial_input)
+        return -1;
+    return *serial_input++;
+}
+
+int HardwareSerial::availableForWrite() {
+    return 63;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    counters.serial_bytes++;
+    if (serial_output_length < sizeof(serial_output) - 1) {
+        serial_output[serial_output_length++] = c;
+        serial_output[serial_output_length] = '\0';
+    }
+    if (!serial_muted)
+        putchar(c);
+    return 1;
+}
+
+size_t HardwareSerial::write(const char *str) {
+    size_t n = 0;
+    while (*str)
+        n += write((uint8_t)*str++);
+    return n;
+}
+
+size_t HardwareSerial::print(const char *str) {
+    return write(str);
+}
+
+size_t HardwareSerial::print(const __FlashStringHelper *str) {
+    return write(reinterpret_cast<const char *>(str));
+}
+
+size_t HardwareSerial::print(char c) {
+    return write((uint8_t)c);
+}
+
+size_t HardwareSerial::print(int n) {
+    return print((long)n);
+}
+
+size_t HardwareSerial::print(unsigned int n) {
+    return print((unsigned long)n);
+}
+
+size_t HardwareSerial::print(long n) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%ld", n);
+    return write(buf);
+}
+
+size_t HardwareSerial::print(unsigned long n) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%lu", n);
+    return write(buf);
+}
+
+size_t HardwareSerial::print(double d, int digits) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", digits, d);
+    return write(buf);
+}
+
+size_t HardwareSerial::println() {
+    return write("\r\n");
+}
+
+size_t HardwareSerial::println(const char *str) {
+    return print(str) + println();
+}
+
+size_t HardwareSerial::println(const __FlashStringHelper *str) {
+    return print(str) + println();
+}
+
+size_t HardwareSerial::println(int n) {
+    return print(n) + println();
+}
+
+size_t HardwareSerial::println(unsigned int n) {
+    return print(n) + println();
+}
+
+size_t HardwareSerial::println(long n) {
+    return print(n) + println();
+}
+
+size_t HardwareSerial::println(unsigned long n) {
+    return print(n) + println();
+}
+
+size_t HardwareSerial::println(double d, int digits) {
+    return print(d, digits) + println();
+}
+
+void HardwareSerial::flush() {
+    if (!serial_muted)
+        fflush(stdout);
+}
@@ -0,0 +1,134 @@
+
+/**
+ * @brief A stand-in for the Arduino core so the firmware in src/ can be
+ * built and run on the host (the 'native' env in platformio.ini).
+ *
+ * Only the parts of the Arduino API that this project uses are here. The
+ * GPIO, time and interrupt calls are backed by native/Arduino.cc, which
+ * also counts pin activity; see native_hal.h for the instrumentation.
+ */
+
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define LED_BUILTIN 13
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#define NUM_DIGITAL_PINS 20
+
+#define _BV(bit) (1 << (bit))
+
+#define NOT_AN_INTERRUPT -1
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : NOT_AN_INTERRUPT))
+
+// Flash strings are plain strings on the host
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+#define PSTR(s) (s)
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define strncpy_P strncpy
+#define strcpy_P strcpy
+#define strlen_P strlen
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+int analogRead(uint8_t pin);
+
+void shiftOut(uint8_t data_pin, uint8_t clock_pin, uint8_t bit_order, uint8_t val);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+void attachInterrupt(uint8_t interrupt_num, void (*user_func)(), int mode);
+void detachInterrupt(uint8_t interrupt_num);
+
+void cli();
+void sei();
+
+// Saved and restored around critical sections that may run in an ISR
+extern volatile uint8_t SREG;
+
+/**
+ * @brief The host version of HardwareSerial. Output goes to stdout unless
+ * it has been muted with hal_serial_mute(); input comes from the buffer
+ * loaded with hal_serial_input().
+ */
+class HardwareSerial {
+public:
+    void begin(unsigned long baud);
+    void end() {}
+
+    int available();
+    int read();
+    int availableForWrite();
+
+    size_t write(uint8_t c);
+    size_t write(const char *str);
+
+    size_t print(const char *str);
+    size_t print(const __FlashStringHelper *str);
+    size_t print(char c);
+    size_t print(int n);
+    size_t print(unsigned int n);
+    size_t print(long n);
+    size_t print(unsigned long n);
+    size_t print(double d, int digits = 2);
+
+    size_t println();
+    size_t println(const char *str);
+    size_t println(const __FlashStringHelper *str);
+    size_t println(int n);
+    size_t println(unsigned int n);
+    size_t println(long n);
+    size_t println(unsigned long n);
+    size_t println(double d, int digits = 2);
+
+    void flush();
+
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif // NATIVE_ARDUINO_H
@@ -0,0 +1,12 @@
+
+/**
+ * @brief Host stand-in for the PinChangeInterrupt library. main.cpp
+ * includes it but nothing in src/ uses a pin change interrupt yet.
+ */
+
+#ifndef NATIVE_PIN_CHANGE_INTERRUPT_H
+#define NATIVE_PIN_CHANGE_INTERRUPT_H
+
+#include <Arduino.h>
+
+#endif // NATIVE_PIN_CHANGE_INTERRUPT_H
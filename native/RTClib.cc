@@ -0,0 +1,150 @@
+
+/**
+ * @brief Host stand-in for RTClib. The date math follows RTClib.cpp.
+ */
+
+#include <RTClib.h>
+
+#include "native_hal.h"
+
+static const uint8_t days_in_month[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30};
+
+static uint16_t date2days(uint16_t y, uint8_t m, uint8_t d) {
+    if (y >= 2000U)
+        y -= 2000U;
+    uint16_t days = d;
+    for (uint8_t i = 1; i < m; ++i)
+        days += days_in_month[i - 1];
+    if (m > 2 && y % 4 == 0)
+        ++days;
+    return days + 365 * y + (y + 3) / 4 - 1;
+}
+
+static uint8_t conv2d(const char *p) {
+    uint8_t v = 0;
+    if ('0' <= *p && *p <= '9')
+        v = *p - '0';
+    return 10 * v + *++p - '0';
+}
+
+DateTime::DateTime(uint32_t t) {
+    t -= SECONDS_FROM_1970_TO_2000;
+
+    ss = t % 60;
+    t /= 60;
+    mm = t % 60;
+    t /= 60;
+    hh = t % 24;
+    uint16_t days = t / 24;
+    uint8_t leap;
+    for (yOff = 0;; ++yOff) {
+        leap = yOff % 4 == 0;
+        if (days < 365U + leap)
+            break;
+        days -= 365 + leap;
+    }
+    for (m = 1; m < 12; ++m) {
+        uint8_t days_per_month = days_in_month[m - 1];
+        if (leap && m == 2)
+            ++days_per_month;
+        if (days < days_per_month)
+            break;
+        days -= days_per_month;
+    }
+    d = days + 1;
+}
+
+DateTime::DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t min, uint8_t sec) {
+    if (year >= 2000U)
+        year -= 2000U;
+    yOff = year;
+    m = month;
+    d = day;
+    hh = hour;
+    mm = min;
+    ss = sec;
+}
+
+// date = "Dec 26 2009", time = "12:34:56"
+DateTime::DateTime(const char *date, const char *time) {
+    yOff = conv2d(date + 9);
+    switch (date[0]) {
+    case 'J':
+        m = (date[1] == 'a') ? 1 : ((date[2] == 'n') ? 6 : 7);
+        break;
+    case 'F':
+        m = 2;
+        break;
+    case 'A':
+        m = date[2] == 'r' ? 4 : 8;
+        break;
+    case 'M':
+        m = date[2] == 'r' ? 3 : 5;
+        break;
+    case 'S':
+        m = 9;
+        break;
+    case 'O':
+        m = 10;
+        break;
+    case 'N':
+        m = 11;
+        break;
+    case 'D':
+        m = 12;
+        break;
+    }
+    d = conv2d(date + 4);
+    hh = conv2d(time);
+    mm = conv2d(time + 3);
+    ss = conv2d(time + 6);
+}
+
+DateTime::DateTime(const __FlashStringHelper *date, const __FlashStringHelper *time)
+    : DateTime(reinterpret_cast<const char *>(date), reinterpret_cast<const char *>(time)) {
+}
+
+uint8_t DateTime::dayOfTheWeek() const {
+    uint16_t day = date2days(yOff, m, d);
+    return (day + 6) % 7;  // Jan 1, 2000 is a Saturday, i.e. returns 6
+}
+
+uint32_t DateTime::unixtime() const {
+    uint16_t days = date2days(yOff, m, d);
+    uint32_t t = ((days * 24UL + hh) * 60 + mm) * 60 + ss;
+    return t + SECONDS_FROM_1970_TO_2000;
+}
+
+DateTime DateTime::operator+(const TimeSpan &span) const {
+    return DateTime(unixtime() + span.totalseconds());
+}
+
+DateTime DateTime::operator-(const TimeSpan &span) const {
+    return DateTime(unixtime() - span.totalseconds());
+}
+
+TimeSpan DateTime::operator-(const DateTime &right) const {
+    return TimeSpan(unixtime() - right.unixtime());
+}
+
+// The simulated chip
+
+static uint32_t rtc_time = SECONDS_FROM_1970_TO_2000;
+static unsigned long rtc_read_count = 0;
+
+void hal_rtc_set(uint32_t unixtime) {
+    rtc_time = unixtime;
+}
+
+unsigned long hal_rtc_reads() {
+    return rtc_read_count;
+}
+
+DateTime RTC_Native::now() {
+    rtc_read_count++;
+    return DateTime(rtc_time);
+}
+
+void RTC_Native::adjust(const DateTime &dt) {
+    rtc_time = dt.unixtime();
+}
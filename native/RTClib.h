@@ -0,0 +1,96 @@
+
+/**
+ * @brief Host stand-in for the parts of Adafruit's RTClib used here.
+ *
+ * DateTime and TimeSpan behave like the real ones (2000-2099). The
+ * RTC_DS3231/RTC_DS1307 classes return the time set with hal_rtc_set()
+ * and count the reads so the bench can see how often the 'bus' is used.
+ */
+
+#ifndef NATIVE_RTCLIB_H
+#define NATIVE_RTCLIB_H
+
+#include <Arduino.h>
+
+#define SECONDS_FROM_1970_TO_2000 946684800
+
+class TimeSpan;
+
+class DateTime {
+public:
+    DateTime(uint32_t t = SECONDS_FROM_1970_TO_2000);
+    DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour = 0, uint8_t min = 0, uint8_t sec = 0);
+    DateTime(const char *date, const char *time);
+    DateTime(const __FlashStringHelper *date, const __FlashStringHelper *time);
+
+    uint16_t year() const { return 2000U + yOff; }
+    uint8_t month() const { return m; }
+    uint8_t day() const { return d; }
+    uint8_t hour() const { return hh; }
+    uint8_t minute() const { return mm; }
+    uint8_t second() const { return ss; }
+    uint8_t dayOfTheWeek() const;
+
+    uint32_t unixtime() const;
+
+    DateTime operator+(const TimeSpan &span) const;
+    DateTime operator-(const TimeSpan &span) const;
+    TimeSpan operator-(const DateTime &right) const;
+
+    bool operator<(const DateTime &right) const { return unixtime() < right.unixtime(); }
+    bool operator==(const DateTime &right) const { return unixtime() == right.unixtime(); }
+    bool operator!=(const DateTime &right) const { return !(*this == right); }
+
+protected:
+    uint8_t yOff, m, d, hh, mm, ss;
+};
+
+class TimeSpan {
+public:
+    TimeSpan(int32_t seconds = 0) : _seconds(seconds) {}
+    TimeSpan(int16_t days, int8_t hours, int8_t minutes, int8_t seconds)
+        : _seconds((int32_t)days * 86400L + (int32_t)hours * 3600 + (int32_t)minutes * 60 + seconds) {}
+
+    int32_t totalseconds() const { return _seconds; }
+
+protected:
+    int32_t _seconds;
+};
+
+enum Ds3231SqwPinMode {
+    DS3231_OFF = 0x1C,
+    DS3231_SquareWave1Hz = 0x00,
+    DS3231_SquareWave1kHz = 0x08,
+    DS3231_SquareWave4kHz = 0x10,
+    DS3231_SquareWave8kHz = 0x18
+};
+
+enum Ds1307SqwPinMode {
+    DS1307_OFF = 0x00,
+    DS1307_ON = 0x80,
+    DS1307_SquareWave1HZ = 0x10,
+    DS1307_SquareWave4kHz = 0x11,
+    DS1307_SquareWave8kHz = 0x12,
+    DS1307_SquareWave32kHz = 0x13
+};
+
+class RTC_Native {
+public:
+    bool begin() { return true; }
+    DateTime now();
+    void adjust(const DateTime &dt);
+    bool lostPower() { return false; }
+};
+
+class RTC_DS3231 : public RTC_Native {
+public:
+    void writeSqwPinMode(Ds3231SqwPinMode) {}
+    float getTemperature() { return 25.0; }
+};
+
+class RTC_DS1307 : public RTC_Native {
+public:
+    void writeSqwPinMode(Ds1307SqwPinMode) {}
+};
+
+#endif // NATIVE_RTCLIB_H
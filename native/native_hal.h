@@ -0,0 +1,62 @@
+
+/**
+ * @brief Instrumentation and stimulus for the host build of the firmware.
+ *
+ * The bench runner (bench/bench.cc) and any Unity tests under test/ use
+ * these to drive the clock (millis()), fire the INT0/INT1 handlers that
+ * were registered with attachInterrupt(), set the simulated RTC and count
+ * what the firmware did to the GPIO pins.
+ */
+
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+
+#include <Arduino.h>
+
+/// Counts of pin activity since the last hal_reset_counters()
+struct hal_counters {
+    unsigned long writes;           // digitalWrite() calls
+    unsigned long toggles;          // digitalWrite() calls that changed a pin
+    unsigned long pin_toggles[NUM_DIGITAL_PINS];  // per-pin toggles
+    unsigned long shift_outs;       // shiftOut() calls
+    unsigned long analog_writes;    // analogWrite() calls
+    unsigned long cli_calls;        // cli() calls
+    unsigned long serial_bytes;     // bytes written to Serial
+};
+
+void hal_reset();
+void hal_reset_counters();
+const hal_counters &hal_get_counters();
+
+int hal_pin_level(uint8_t pin);
+int hal_pin_mode(uint8_t pin);
+int hal_analog_value(uint8_t pin);
+
+// Drive an input; this does not fire interrupts, use hal_fire_pin()
+void hal_set_pin(uint8_t pin, int level);
+// Set an input and call the handler attached to it if the edge matches
+void hal_fire_pin(uint8_t pin, int level);
+
+void hal_set_analog_input(uint8_t pin, int value);
+
+// Called after each digitalWrite() that changes a pin, e.g. to model the
+// 595 chain; nullptr for none
+void hal_on_toggle(void (*hook)(uint8_t pin, uint8_t level));
+
+void hal_set_millis(unsigned long ms);
+void hal_advance_millis(unsigned long ms);
+
+void hal_serial_mute(bool mute);
+void hal_serial_input(const char *text);
+// What was written to Serial since hal_reset() or hal_serial_clear(), muted
+// or not; only the first HAL_SERIAL_CAPTURE - 1 bytes are kept
+#define HAL_SERIAL_CAPTURE 2048
+const char *hal_serial_output();
+void hal_serial_clear();
+
+// Set the time the simulated RTC will return from now()
+void hal_rtc_set(uint32_t unixtime);
+// Number of times the simulated RTC was read
+unsigned long hal_rtc_reads();
+
+#endif // NATIVE_HAL_H
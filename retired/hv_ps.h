@@ -1,5 +0,0 @@
-
-#define SAMPLE_PERIOD 10  // ms
-
-void hv_ps_setup();
-void hv_ps_adjust();
@@ -7,10 +7,75 @@
 #include <Arduino.h>
 #include <RTClib.h> // https://github.com/adafruit/RTClib
 
+#include "colon.h"
+#include "display.h"
+#include "fast_pin.h"
 #include "print.h"
 #include "pins.h"
+#include "profile.h"
+#include "scheduler.h"
+#include "settings.h"
+#include "timebase.h"
+#include "tz.h"
+
+#ifndef RTC_RESYNC_INTERVAL
+#define RTC_RESYNC_INTERVAL 0  // Seconds; 0 reads the RTC every second
+#endif
+
+#ifndef RTC_ASYNC
+#define RTC_ASYNC 0
+#endif
+
+#ifndef RTC_RAW_BCD
+#define RTC_RAW_BCD 0
+#endif
+
+#if RTC_RAW_BCD && !RTC_ASYNC
+#error "RTC_RAW_BCD needs RTC_ASYNC"
+#endif
+
+#if RTC_ASYNC
+// Talk to the RTC with the non-blocking TWI driver instead of RTClib/Wire.
+// RTClib is still used for DateTime.
+#include "twi_async.h"
 
+#ifndef __AVR__
+#error "RTC_ASYNC needs the AVR TWI hardware"
+#endif
+
+// The DS3231 and DS1307 share an address and the layout of the time
+// registers (0x00 - 0x06, BCD)
+#define RTC_ADDRESS 0x68
+#define RTC_TIME_REG 0x00
 #if USE_DS3231
+#define RTC_CONTROL_REG 0x0E
+#define RTC_STATUS_REG 0x0F
+#elif USE_DS1307
+#define RTC_CONTROL_REG 0x07
+#endif
+
+#if RTC_RAW_BCD
+// The per-second/resync read gets every register in one burst: the time
+// and date, and for the DS3231 the control, status and temperature too.
+#if USE_DS3231
+#define RTC_REG_COUNT 0x13
+#define RTC_TEMP_REG 0x11
+#elif USE_DS1307
+#define RTC_REG_COUNT 0x08
+#endif
+#else
+#define RTC_REG_COUNT 7
+#endif
+
+static uint8_t rtc_regs[RTC_REG_COUNT];  // Filled by the async read
+
+#if RTC_RAW_BCD
+// The time shown: seconds, minutes and hours in the RTC's BCD format,
+// which is also the display's format.
+static uint8_t bcd_time[3];
+#endif
+
+#elif USE_DS3231
 RTC_DS3231 rtc;
 #elif USE_DS1307
 RTC_DS1307 rtc;
@@ -22,42 +87,84 @@ RTC_DS1307 rtc;
 // DateTime cannot be 'volatile' given its definition
 DateTime dt;
 
-// The current display digits
-volatile int digit_0;
-volatile int digit_1;
-volatile int digit_2;
-volatile int digit_3;
-volatile int digit_4;
-volatile int digit_5;
+#if RTC_UTC
+// dt, bcd_time and bcd_date are local time; the RTC keeps UTC. The offset
+// is looked up when the RTC is read and kept until the next change.
+static long utc_offset_s = 0;
+static uint32_t tz_seconds_left = 0;  // Until the offset changes
+
+#if RTC_RAW_BCD
+static uint8_t bcd_date[3];  // The local date: year, day and month, BCD
+#endif
 
+static DateTime local_time(const DateTime &utc) {
+    uint32_t t = utc.unixtime();
+    uint32_t until;
+    utc_offset_s = tz_offset(t, until) * 60L;
+    tz_seconds_left = until - t;
+    return DateTime(t + utc_offset_s);
+}
+#else
+static const long utc_offset_s = 0;
+
+static DateTime local_time(const DateTime &t) {
+    return t;
+}
+#endif
+
+#if RTC_RAW_BCD
+void update_display_with_time() {
+    display_set_pair(0, bcd_time[0]);
+    display_set_pair(1, bcd_time[1]);
+    display_set_pair(2, bcd_time[2]);
+}
+#else
 void update_display_with_time() {
-    digit_0 = dt.second() % 10;
-    digit_1 = dt.second() / 10;
+    display_set_digit(0, dt.second() % 10);
+    display_set_digit(1, dt.second() / 10);
 
-    digit_2 = dt.minute() % 10;
-    digit_3 = dt.minute() / 10;
+    display_set_digit(2, dt.minute() % 10);
+    display_set_digit(3, dt.minute() / 10);
 
-    digit_4 = dt.hour() % 10;
-    digit_5 = dt.hour() / 10;
+    display_set_digit(4, dt.hour() % 10);
+    display_set_digit(5, dt.hour() / 10);
 }
+#endif
 
 // mm/dd/yy
+#if RTC_RAW_BCD && RTC_UTC
+// The local date from the last read; a read is forced at midnight
+void update_display_with_date() {
+    display_set_pair(0, bcd_date[0]);
+    display_set_pair(1, bcd_date[1]);
+    display_set_pair(2, bcd_date[2]);
+}
+#elif RTC_RAW_BCD
+// The date registers are from the last read; a read is forced at midnight
+void update_display_with_date() {
+    display_set_pair(0, rtc_regs[6]);
+    display_set_pair(1, rtc_regs[4]);
+    display_set_pair(2, rtc_regs[5] & 0x1F);
+}
+#else
 void update_display_with_date() {
-    digit_0 = dt.year() % 10;
-    digit_1 = (dt.year() - 2000) / 10;
+    display_set_digit(0, dt.year() % 10);
+    display_set_digit(1, (dt.year() - 2000) / 10);
 
-    digit_2 = dt.day() % 10;
-    digit_3 = dt.day() / 10;
+    display_set_digit(2, dt.day() % 10);
+    display_set_digit(3, dt.day() / 10);
 
-    digit_4 = dt.month() % 10;
-    digit_5 = dt.month() / 10;
+    display_set_digit(4, dt.month() % 10);
+    display_set_digit(5, dt.month() / 10);
 }
+#endif
 
 /**
  * Print the values of the current digits
  */
 void print_digits(bool newline) {
-    print("%01d-%01d-%01d-%01d-%01d-%01d\n", digit_5, digit_4, digit_3, digit_2, digit_1, digit_0);
+    PRINT("%01d-%01d-%01d-%01d-%01d-%01d\n", display_digit(5), display_digit(4), display_digit(3),
+          display_digit(2), display_digit(1), display_digit(0));
 }
 
 /**
@@ -65,9 +172,9 @@ void print_digits(bool newline) {
  */
 void print_time(const DateTime &dt, bool print_newline = false) {
     // or Serial.println(now.toString(buffer));, buffer == YY/MM/DD hh:mm:ss
-    print("%02d/%02d/%02d %02d:%02d:%02d", dt.year(), dt.month(), dt.day(), dt.hour(), dt.minute(), dt.second());
+    PRINT("%02u/%02d/%02d %02d:%02d:%02d", dt.year(), dt.month(), dt.day(), dt.hour(), dt.minute(), dt.second());
     if (print_newline)
-        print("\n");
+        PRINT("\n");
 }
 
 // should the clock be checked and the display updated?
@@ -75,6 +182,38 @@ volatile bool update_display = false;
 
 volatile bool toggle = false;
 
+// dt has changed and the display should show it
+static bool time_changed = false;
+
+// millis() at the last falling SQW edge, the start of the second
+volatile unsigned long sqw_last_edge_ms = 0;
+
+// Counts of RTC reads since boot
+unsigned long rtc_reads = 0;
+unsigned int rtc_read_errors = 0;
+
+#if RTC_RESYNC_INTERVAL
+// Software timekeeping: dt is advanced by counting full cycles of the
+// 1Hz square wave and the RTC is read only every RTC_RESYNC_INTERVAL
+// seconds or when the square wave looks wrong.
+
+// Edges closer together or farther apart than this (ms) are bad ticks.
+// millis() runs on the MCU's resonator, so leave plenty of slack.
+#define SQW_MIN_PERIOD 750
+#define SQW_MAX_PERIOD 1250
+
+volatile uint8_t sqw_pending_seconds = 0;  // Full SQW cycles not yet added to dt
+volatile bool sqw_have_edge = false;        // sqw_last_edge_ms is a real edge
+volatile bool sqw_drift_check_failed = false;
+
+// Counts of bad ticks and RTC reads since boot
+volatile unsigned int sqw_skipped_ticks = 0;     // An edge came late; one or more were missed
+volatile unsigned int sqw_duplicate_ticks = 0;   // An edge came early; it was ignored
+unsigned int rtc_corrections = 0;  // Resyncs where dt did not match the RTC
+
+uint16_t seconds_since_resync = 0;
+#endif
+
 /**
  * @brief Record that 1/2 second has elapsed
  *
@@ -83,30 +222,222 @@ volatile bool toggle = false;
  * colon that is the clock digit separator so that it fashes on and off
  * once per second.
  *
- * This ISR is also used to trigger the digit update once per second.
+ * This ISR is also used to trigger the digit update once per second, on
+ * the falling edge. The DS3231 advances its seconds register on that edge
+ * (the square wave goes high 500ms later).
  *
  * The volatile bools toggle and update_display are used to signal other
- * parts of the code that the colons or digits should be updated.
+ * parts of the code that the colons or digits should be updated, and the
+ * time task is posted to do it. With COLON_TIMER1 the colon is Timer1's
+ * and this only keeps it in phase.
  */
 void timer_2HZ_tick_ISR() {
+    PROFILE_SCOPE(probe_sqw_isr);
+
+    bool second = !fast_pin<CLOCK_1HZ>::read();
+#if COLON_TIMER1
+    colon_sqw_edge(second);
+#else
     toggle = true;
+#endif
+    sched_post(task_time);
+
+    if (!second)
+        return;
+
+    unsigned long now = millis();
+#if RTC_RESYNC_INTERVAL
+    // The first edge has nothing to be measured against
+    if (sqw_have_edge) {
+        unsigned long period = now - sqw_last_edge_ms;
+
+        if (period < SQW_MIN_PERIOD) {
+            sqw_duplicate_ticks++;
+            return;
+        }
+
+        if (period > SQW_MAX_PERIOD) {
+            sqw_skipped_ticks++;
+            sqw_drift_check_failed = true;
+        }
+    }
 
-    static volatile bool tick_tok = true;
+    sqw_have_edge = true;
+    sqw_last_edge_ms = now;
+    sqw_pending_seconds++;
+#else
+    sqw_last_edge_ms = now;
+#endif
 
-    if (tick_tok) {
-        tick_tok = false;
-        update_display = true;
-    } else {
-        tick_tok = true;
+    timebase_edge();
+
+    update_display = true;
+}
+
+#if RTC_ASYNC
+static uint8_t bcd2bin(uint8_t val) {
+    return val - 6 * (val >> 4);
+}
+
+static uint8_t bin2bcd(uint8_t val) {
+    return val + 6 * (val / 10);
+}
+
+static DateTime decode_time(const uint8_t *regs) {
+    return DateTime(2000 + bcd2bin(regs[6]), bcd2bin(regs[5] & 0x1F), bcd2bin(regs[4]), bcd2bin(regs[2] & 0x3F),
+                    bcd2bin(regs[1]), bcd2bin(regs[0] & 0x7F));
+}
+
+#if RTC_RAW_BCD
+#if RTC_UTC
+// The registers are UTC; the local time is made once per read
+static void load_bcd_time() {
+    DateTime local = local_time(decode_time(rtc_regs));
+    bcd_time[0] = bin2bcd(local.second());
+    bcd_time[1] = bin2bcd(local.minute());
+    bcd_time[2] = bin2bcd(local.hour());
+    bcd_date[0] = bin2bcd(local.year() - 2000U);
+    bcd_date[1] = bin2bcd(local.day());
+    bcd_date[2] = bin2bcd(local.month());
+}
+#else
+// Mask off the DS1307 CH bit and the 12/24 hour bit
+static void load_bcd_time() {
+    bcd_time[0] = rtc_regs[0] & 0x7F;
+    bcd_time[1] = rtc_regs[1] & 0x7F;
+    bcd_time[2] = rtc_regs[2] & 0x3F;
+}
+#endif
+
+/**
+ * @brief Add one to a BCD value; wrap to zero at limit
+ * @return true if the value wrapped
+ */
+static bool bcd_increment(uint8_t &val, uint8_t limit) {
+    val++;
+    if ((val & 0x0F) == 0x0A)
+        val += 6;
+    if (val >= limit) {
+        val = 0;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Add a second to bcd_time
+ * @return true at midnight, when the date in rtc_regs is out of date
+ */
+static bool bcd_tick() {
+    return bcd_increment(bcd_time[0], 0x60) && bcd_increment(bcd_time[1], 0x60) && bcd_increment(bcd_time[2], 0x24);
+}
+
+#if USE_DS3231
+/**
+ * @brief The temperature from the last burst read, in 1/4 degrees C
+ */
+int16_t rtc_temperature() {
+    return ((int8_t)rtc_regs[RTC_TEMP_REG] << 2) | (rtc_regs[RTC_TEMP_REG + 1] >> 6);
+}
+
+/**
+ * @brief The status register from the last burst read. Bit 7 (OSF) set
+ * means the oscillator stopped and the time can't be trusted.
+ */
+uint8_t rtc_status() {
+    return rtc_regs[RTC_STATUS_REG];
+}
+#endif
+#endif
+
+static bool read_registers(uint8_t reg, uint8_t *buf, uint8_t n) {
+    return twi_start_read(RTC_ADDRESS, reg, buf, n) && twi_wait() == twi_done;
+}
+
+static bool write_registers(uint8_t reg, const uint8_t *buf, uint8_t n) {
+    return twi_start_write(RTC_ADDRESS, reg, buf, n) && twi_wait() == twi_done;
+}
+
+// The blocking calls, used by setup() and to set the time. The bus is
+// recovered first in case a reset left the RTC in the middle of a read.
+static bool rtc_begin() {
+    twi_bus_recover();
+    uint8_t seconds;
+    return read_registers(RTC_TIME_REG, &seconds, 1);
+}
+
+static DateTime rtc_now() {
+    rtc_reads++;
+    if (!read_registers(RTC_TIME_REG, rtc_regs, sizeof(rtc_regs))) {
+        rtc_read_errors++;
+        return dt - TimeSpan(utc_offset_s);  // dt is local time; this returns the RTC's
     }
+    return decode_time(rtc_regs);
 }
 
+// Set the time; this blocks for a few ms
+void rtc_adjust(const DateTime &t) {
+    twi_wait();  // Let a read that is under way finish
+    uint8_t dow = t.dayOfTheWeek();
+    uint8_t regs[7] = {bin2bcd(t.second()), bin2bcd(t.minute()), bin2bcd(t.hour()),
+                       (uint8_t)(dow == 0 ? 7 : dow), bin2bcd(t.day()), bin2bcd(t.month()),
+                       bin2bcd(t.year() - 2000U)};
+    write_registers(RTC_TIME_REG, regs, sizeof(regs));  // Also clears the DS1307 CH bit
+#if USE_DS3231
+    uint8_t status;
+    if (read_registers(RTC_STATUS_REG, &status, 1)) {
+        status &= ~0x80;  // Clear OSF
+        write_registers(RTC_STATUS_REG, &status, 1);
+    }
+#endif
+}
+
+static void rtc_sqw_1hz() {
+#if USE_DS3231
+    uint8_t control;
+    if (read_registers(RTC_CONTROL_REG, &control, 1)) {
+        control &= ~0x1C;  // INTCN = 0, RS2:RS1 = 00 --> 1Hz square wave
+        write_registers(RTC_CONTROL_REG, &control, 1);
+    }
+#elif USE_DS1307
+    uint8_t control = 0x10;  // SQWE = 1, RS1:RS0 = 00 --> 1Hz
+    write_registers(RTC_CONTROL_REG, &control, 1);
+#endif
+}
+#else
+static bool rtc_begin() {
+    return rtc.begin();
+}
+
+static DateTime rtc_now() {
+    rtc_reads++;
+    return rtc.now();  // This call takes about 1ms
+}
+
+// Set the time; this blocks for a few ms
+void rtc_adjust(const DateTime &t) {
+    rtc.adjust(t);
+}
+
+static void rtc_sqw_1hz() {
+#if USE_DS3231
+    rtc.writeSqwPinMode(DS3231_SquareWave1Hz);
+#elif USE_DS1307
+    rtc.writeSqwPinMode(DS1307_SquareWave1HZ);
+#endif
+}
+#endif
+
 void RTC_setup() {
 
-    pinMode(SEPARATOR, OUTPUT);
-    digitalWrite(SEPARATOR, LOW);
+#if COLON_TIMER1
+    colon_setup();
+#else
+    fast_pin<SEPARATOR>::output();
+    fast_pin<SEPARATOR>::low();
+#endif
 
-    if (rtc.begin()) {
+    if (rtc_begin()) {
         DPRINT("DS3131/DS1307 RTC Start\n");
     } else {
         DPRINT("Couldn't find RTC\n");
@@ -123,7 +454,13 @@ void RTC_setup() {
     DateTime build_time = DateTime(F(__DATE__), F(__TIME__));
     TimeSpan ts(ADJUST_TIME);
     build_time = build_time + ts;
-    DateTime now = rtc.now();
+#if RTC_UTC
+    // The build time is local; the offset at that time read as UTC is off
+    // only within hours of a change
+    uint32_t until;
+    build_time = build_time - TimeSpan(tz_offset(build_time.unixtime(), until) * 60L);
+#endif
+    DateTime now = rtc_now();
 
     Serial.print(now.unixtime());
     Serial.print(", ");
@@ -133,26 +470,28 @@ void RTC_setup() {
         Serial.print("Adjusting the time: ");
         print_time(build_time, true);
 
-        rtc.adjust(build_time);
+        rtc_adjust(build_time);
     }
 #endif
 
-#if USE_DS3231
-    rtc.writeSqwPinMode(DS3231_SquareWave1Hz);
-#elif USE_DS1307
-    rtc.writeSqwPinMode(DS1307_SquareWave1HZ);
-#endif
+    rtc_sqw_1hz();
 
-    dt = rtc.now();
+    dt = local_time(rtc_now());
     print_time(dt, true);
+#if RTC_RAW_BCD
+    load_bcd_time();
+#endif
+    // Only a guess at the phase, for time_now(); the ISR takes the first
+    // edge as it comes
+    sqw_last_edge_ms = millis();
 
     cli(); // stop interrupts
 
     // This is used for the 1Hz pulse from the clock that triggers
     // time updates.
-    pinMode(CLOCK_1HZ, INPUT_PULLUP);
+    fast_pin<CLOCK_1HZ>::input_pullup();
 
-    // time_2Hz_tick_ISR() sets a flag that is tested in loop()
+    // timer_2HZ_tick_ISR() sets a flag and posts the time task
     attachInterrupt(digitalPinToInterrupt(CLOCK_1HZ), timer_2HZ_tick_ISR, CHANGE);
 
     sei(); // start interrupts
@@ -162,33 +501,374 @@ void toggle_separator() {
     static bool tick_tok = true;
     if (tick_tok) {
         // turn on separator
-        // faster than digitalWrite()
-        //PORTB &= ~_BV(SEPARATOR - 8);  // i.e., digitalWrite(SEPARATOR, LOW);
-        digitalWrite(SEPARATOR, HIGH);
+        fast_pin<SEPARATOR>::high();
         tick_tok = false;
     } else {
         // turn off separator
-        //PORTB |= _BV(SEPARATOR - 8);  // digitalWrite(SEPARATOR, HIGH);
-        digitalWrite(SEPARATOR, LOW);
+        fast_pin<SEPARATOR>::low();
         tick_tok = true;
     }
 }
 
-// Call at least twice a second
+/**
+ * Print the RTC and software timekeeping counters
+ */
+void print_time_stats() {
+    PRINT("RTC reads: %lu, errors: %u\n", rtc_reads, rtc_read_errors);
+    flush();
+#if RTC_RESYNC_INTERVAL
+    PRINT("RTC corrections: %u, SQW skipped: %u, duplicate: %u\n", rtc_corrections, sqw_skipped_ticks,
+          sqw_duplicate_ticks);
+    flush();
+#endif
+#if RTC_UTC
+    print_tz_stats();
+    flush();
+#endif
+#if RTC_RAW_BCD && USE_DS3231
+    int16_t t = rtc_temperature();  // In 0.25C steps
+    PRINT("RTC temperature: %fC, status: 0x%02x\n", print_fixed_point<2>(t * 25L), rtc_status());
+#endif
+}
+
+/**
+ * @brief Use a time read from the RTC
+ *
+ * With software timekeeping, count the times the RTC disagrees with dt.
+ */
+static void rtc_time_ready(const DateTime &rtc_time) {
+#if RTC_RESYNC_INTERVAL
+    long drift = (long)(rtc_time.unixtime() - dt.unixtime());
+    if (drift != 0) {
+        rtc_corrections++;
+        time_changed = true;
+        DPRINTV("RTC resync, dt was off by %ld s\n", drift);
+    }
+    dt = rtc_time;
+#if DEBUG
+    print_time_stats();
+#endif
+#else
+    dt = rtc_time;
+    time_changed = true;
+#endif
+}
+
+#if RTC_RAW_BCD
+/**
+ * @brief Use the registers from a burst read
+ *
+ * The BCD time goes straight to bcd_time; there's no DateTime and no
+ * division. With software timekeeping, count the times the RTC disagrees
+ * with bcd_time.
+ */
+static void rtc_regs_ready() {
+#if RTC_RESYNC_INTERVAL
+    uint8_t old_time[3] = {bcd_time[0], bcd_time[1], bcd_time[2]};
+    load_bcd_time();
+    if (memcmp(old_time, bcd_time, sizeof(bcd_time)) != 0) {
+        rtc_corrections++;
+        time_changed = true;
+        DPRINTV("RTC resync, time was %02x:%02x:%02x\n", old_time[2], old_time[1], old_time[0]);
+    }
+#if DEBUG
+    print_time_stats();
+#endif
+#else
+    load_bcd_time();
+    time_changed = true;
+#endif
+
+#if USE_DS3231
+    static bool osf_reported = false;
+    if ((rtc_status() & 0x80) && !osf_reported) {
+        osf_reported = true;
+        DPRINT("RTC oscillator stopped flag is set; the time may be wrong\n");
+    }
+#endif
+}
+#endif
+
+#if RTC_ASYNC
+/**
+ * @brief The async RTC read is done; called from twi_poll()
+ */
+static void rtc_read_done(twi_status status) {
+    if (status == twi_done) {
+#if RTC_RAW_BCD
+        rtc_regs_ready();
+#else
+        rtc_time_ready(local_time(decode_time(rtc_regs)));
+#endif
+        return;
+    }
+
+    rtc_read_errors++;
+#if RTC_RESYNC_INTERVAL
+    seconds_since_resync = RTC_RESYNC_INTERVAL;  // Try again next second
+#else
+    // Keep the clock running on the MCU until the RTC answers again
+#if RTC_RAW_BCD
+    bcd_tick();
+#else
+    dt = dt + TimeSpan(1);
+#endif
+    time_changed = true;
+#endif
+}
+#endif
+
+/**
+ * @brief Get the time from the RTC
+ *
+ * With RTC_ASYNC this starts the read and rtc_time_ready() is called from
+ * a later time_update_handler() call; otherwise it blocks for about 1ms.
+ */
+static void rtc_request_time() {
+#if RTC_ASYNC
+    rtc_reads++;
+    if (!twi_start_read(RTC_ADDRESS, RTC_TIME_REG, rtc_regs, sizeof(rtc_regs), rtc_read_done))
+        rtc_read_done(twi_error);
+#else
+    rtc_time_ready(local_time(rtc_now()));
+#endif
+}
+
+#if RTC_RESYNC_INTERVAL
+/**
+ * @brief Advance dt by the number of seconds counted by the ISR
+ *
+ * Every RTC_RESYNC_INTERVAL seconds, or when the ISR saw a late edge,
+ * also read the RTC.
+ */
+static void advance_time() {
+    cli();
+    uint8_t seconds = sqw_pending_seconds;
+    sqw_pending_seconds = 0;
+    bool drift_check_failed = sqw_drift_check_failed;
+    sqw_drift_check_failed = false;
+    sei();
+
+    if (seconds > 0) {
+#if RTC_UTC
+        uint8_t elapsed = seconds;
+#endif
+        seconds_since_resync += seconds;
+#if RTC_RAW_BCD
+        while (seconds--) {
+            if (bcd_tick())
+                drift_check_failed = true;  // Midnight: read the new date
+        }
+#else
+        dt = dt + TimeSpan(seconds);
+#endif
+#if RTC_UTC
+        if (tz_seconds_left <= elapsed) {
+            // The UTC offset changes; the read shows the new local time
+            tz_seconds_left = 0;
+            drift_check_failed = true;
+        } else {
+            tz_seconds_left -= elapsed;
+            time_changed = true;
+        }
+#else
+        time_changed = true;
+#endif
+    }
+
+    if (drift_check_failed || seconds_since_resync >= RTC_RESYNC_INTERVAL) {
+        seconds_since_resync = 0;
+        rtc_request_time();
+    }
+}
+#endif
+
+// Setting the time over the serial port; see tools/time_sync.py.
+//
+// The host sends pings and uses the round trip times to find the offset of
+// this clock from its own. Then it asks for the RTC to be set to its next
+// whole second, with the delay from when the request arrives to that
+// second. Writing the seconds register restarts the DS3231's 1Hz divider,
+// so the write sets the phase of the SQW edges as well as the time.
+
+static bool sync_pending = false;
+static unsigned long sync_start_ms;
+static unsigned int sync_delay_ms;
+static uint32_t sync_time;
+
+/**
+ * @brief The time now
+ * @param ms Set to the ms since the start of the second
+ * @return The time in seconds since 1970; UTC if the RTC keeps UTC
+ */
+static uint32_t time_now(unsigned int &ms) {
+    cli();
+    unsigned long edge = sqw_last_edge_ms;
+#if RTC_RESYNC_INTERVAL
+    uint8_t pending = sqw_pending_seconds;  // Not yet added by advance_time()
+#else
+    uint8_t pending = update_display;  // The RTC has not been read yet
+#endif
+    sei();
+#if RTC_ASYNC && !RTC_RESYNC_INTERVAL
+    if (twi_in_progress())
+        pending = 1;
+#endif
+
+    ms = millis() - edge;
+#if RTC_RAW_BCD && RTC_UTC
+    DateTime now(2000 + bcd2bin(bcd_date[0]), bcd2bin(bcd_date[2]), bcd2bin(bcd_date[1]), bcd2bin(bcd_time[2]),
+                 bcd2bin(bcd_time[1]), bcd2bin(bcd_time[0]));
+#elif RTC_RAW_BCD
+    DateTime now(2000 + bcd2bin(rtc_regs[6]), bcd2bin(rtc_regs[5] & 0x1F), bcd2bin(rtc_regs[4]),
+                 bcd2bin(bcd_time[2]), bcd2bin(bcd_time[1]), bcd2bin(bcd_time[0]));
+#else
+    const DateTime &now = dt;
+#endif
+    return now.unixtime() - utc_offset_s + pending;
+}
+
+/**
+ * @brief Answer a host's ping with the time now
+ *
+ * The reply is 'T <token> <seconds since 1970> <ms>'.
+ */
+void time_sync_ping(unsigned long token) {
+    unsigned int ms;
+    uint32_t now = time_now(ms);
+    PRINT("T %lu %lu %u\n", token, now, ms);
+}
+
+/**
+ * @brief Set the time to 't' in 'delay_ms'
+ */
+void time_sync_set(uint32_t t, unsigned int delay_ms) {
+    sync_time = t;
+    sync_delay_ms = delay_ms;
+    sync_start_ms = millis();
+    sync_pending = true;
+    sched_at(task_time, sync_start_ms + delay_ms);
+}
+
+/**
+ * @brief Set the RTC when the delay from time_sync_set() is up
+ *
+ * Called from time_update_handler(), which time_sync_set() scheduled for
+ * the end of the delay and which this schedules again if it runs before
+ * then; Timer0 wakes the CPU every 1ms, so this is late by at most about
+ * that much. The reply is
+ * 'S <seconds since 1970> <ms>', where ms is how far this clock was
+ * ahead before it was set.
+ */
+static void time_sync_apply() {
+    if (!sync_pending)
+        return;
+    if (millis() - sync_start_ms < sync_delay_ms) {
+        // An SQW edge ran the task early, which used up its deadline
+        sched_at(task_time, sync_start_ms + sync_delay_ms);
+        return;
+    }
+    sync_pending = false;
+
+    unsigned int ms;
+    long offset_ms = (int32_t)(time_now(ms) - sync_time) * 1000L + ms;
+
+    rtc_adjust(DateTime(sync_time));
+    timebase_restart();
+
+    // The SQW goes high 500ms after the write and falls at the next second
+    cli();
+    sqw_last_edge_ms = millis();
+    update_display = false;
+#if RTC_RESYNC_INTERVAL
+    sqw_have_edge = false;
+    sqw_pending_seconds = 0;
+    sqw_drift_check_failed = false;
+#endif
+    sei();
+
+    dt = local_time(rtc_now());
+#if RTC_RAW_BCD
+    load_bcd_time();
+#endif
+    time_changed = true;
+
+    settings s = settings_get();
+    s.sync_time = sync_time;
+    s.sync_offset_ms = offset_ms;
+    settings_save(s);
+
+    PRINT("S %lu %ld\n", sync_time, offset_ms);
+}
+
+/**
+ * @brief The hour of the time shown, 0 - 23
+ */
+uint8_t time_hour() {
+#if RTC_RAW_BCD
+    return bcd2bin(bcd_time[2]);
+#else
+    return dt.hour();
+#endif
+}
+
+// A medium switch press shows the date for a while
+static unsigned long date_shown_ms = 0;
+static unsigned int date_show_for = 0;
+
+/**
+ * @brief Put the date in the display's back buffer and leave it there for
+ * 'ms' before the time is shown again
+ */
+void show_date(unsigned int ms) {
+    update_display_with_date();
+    date_shown_ms = millis();
+    date_show_for = ms;
+}
+
+/**
+ * @brief The time task; runs when the SQW ISR posts it, when a time sync
+ * is due and, while an RTC read is in progress, on every pass
+ */
 bool time_update_handler() {
+    PROFILE_SCOPE(probe_time_update);
+
     // every 1/2 second
     if (toggle) {
         toggle = false;
         toggle_separator();
     }
 
+#if RTC_ASYNC
+    twi_poll();  // Finishes a read started by rtc_request_time()
+    if (twi_in_progress())
+        sched_post(task_time);
+#endif
+
+    time_sync_apply();
+
     // every second
     if (update_display) {
         update_display = false;
-        dt = rtc.now();  // This call takes about 1ms
-#if DEBUG
+#if RTC_RESYNC_INTERVAL
+        advance_time();
+#else
+        rtc_request_time();
+#endif
+    }
+
+    if (time_changed) {
+        time_changed = false;
+#if DEBUG && RTC_RAW_BCD
+        PRINT("%02x:%02x:%02x\n", bcd_time[2], bcd_time[1], bcd_time[0]);
+#elif DEBUG
         print_time(dt, true);
 #endif
+        if (date_show_for) {
+            if (millis() - date_shown_ms < date_show_for)
+                return false;
+            date_show_for = 0;
+        }
         update_display_with_time();
         return true;
     } else {
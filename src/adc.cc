@@ -0,0 +1,119 @@
+
+/**
+ * @brief The ADC acquisition stage
+ *
+ * The ADC auto-triggers on the rising edge of OCF0A. The Timer0 compare A
+ * ISR (the tick) clears the flag each time it runs, so there is one
+ * conversion per tick: about 980 a second, well inside the 9.6kHz the ADC
+ * manages at clk/128.
+ *
+ * The ISR is the producer of the ring and adc_read() the consumer. Each
+ * side only writes its own index, so no locks are needed as long as there
+ * is one consumer. The statistics are of the decimated samples since the
+ * last report.
+ */
+
+#include <Arduino.h>
+
+#include "adc.h"
+#include "hv_ps.h"
+#include "print.h"
+
+#if HV_PS
+
+#if ADC_OVERSAMPLE_BITS < 0 || ADC_OVERSAMPLE_BITS > 3
+#error "ADC_OVERSAMPLE_BITS must be 0 - 3; the sum of the samples is 16 bits"
+#endif
+
+#define ADC_SAMPLES 8  // A power of two
+
+static uint16_t samples[ADC_SAMPLES];
+static volatile uint8_t samples_head = 0;
+static volatile uint8_t samples_tail = 0;
+
+// Since the last report
+static volatile unsigned int samples_dropped = 0;
+static volatile unsigned int count = 0;
+static volatile unsigned long sum = 0;
+static volatile uint16_t sample_min = 0xFFFF;
+static volatile uint16_t sample_max = 0;
+
+/**
+ * @brief Start converting 'channel' (0 - 7) on each tick
+ */
+void adc_setup(uint8_t channel) {
+    cli();
+    ADMUX = _BV(REFS0) | (channel & 0x07);  // AVcc reference
+    ADCSRB = _BV(ADTS1) | _BV(ADTS0);       // Timer0 compare A
+    // Enabled, auto-triggered, interrupt on completion, clk/128
+    ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | _BV(ADIF) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+    sei();
+}
+
+ISR(ADC_vect) {
+    static uint16_t total = 0;
+    static uint8_t n = 0;
+
+    total += ADC;
+    if (++n < ADC_OVERSAMPLES)
+        return;
+
+    uint16_t value = total >> ADC_OVERSAMPLE_BITS;
+    total = 0;
+    n = 0;
+
+    uint8_t next = (samples_head + 1) & (ADC_SAMPLES - 1);
+    if (next == samples_tail) {
+        samples_dropped++;
+    } else {
+        samples[samples_head] = value;
+        samples_head = next;
+    }
+
+    count++;
+    sum += value;
+    if (value < sample_min)
+        sample_min = value;
+    if (value > sample_max)
+        sample_max = value;
+}
+
+/**
+ * @brief Take the oldest decimated sample
+ * @return false if there are none
+ */
+bool adc_read(uint16_t &value) {
+    uint8_t tail = samples_tail;
+    if (tail == samples_head)
+        return false;
+    value = samples[tail];
+    samples_tail = (tail + 1) & (ADC_SAMPLES - 1);
+    return true;
+}
+
+/**
+ * @brief Print the min/max/mean of the samples since the last report
+ */
+void print_adc_stats() {
+    cli();
+    unsigned int n = count;
+    unsigned long total = sum;
+    uint16_t low = sample_min;
+    uint16_t high = sample_max;
+    unsigned int dropped = samples_dropped;
+    count = 0;
+    sum = 0;
+    sample_min = 0xFFFF;
+    sample_max = 0;
+    samples_dropped = 0;
+    sei();
+
+    if (n == 0) {
+        PRINT("ADC: no samples\n");
+        return;
+    }
+    PRINT("ADC: %u samples (%d bits), min: %u, max: %u, mean: %lu, dropped: %u\n", n,
+          10 + ADC_OVERSAMPLE_BITS, low, high, total / n, dropped);
+}
+
+#endif  // HV_PS
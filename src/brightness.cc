@@ -0,0 +1,195 @@
+
+/**
+ * @brief Tube brightness
+ *
+ * HV_PWM_CONTROL is OC0B (pin 5), on Timer0, which also runs millis(), so
+ * its PWM is 8 bits at about 980Hz and the period cannot change. The
+ * boards have no other free PWM pin: Timer1 belongs to the HV supply and
+ * the colon, Timer2 to the display refresh. To get more resolution,
+ * brightness_tick() runs once per PWM period (from the Timer0 compare A
+ * ISR) and dithers OCR0B between two neighbouring values, sigma-delta
+ * style, using the 4 low bits of a 12-bit duty cycle.
+ *
+ * The level (0 - 255, perceptual) is kept with 8 fraction bits so ramps
+ * are smooth; the gamma table maps it to the duty cycle. A ramp follows
+ * now_ms(), so it takes BRIGHTNESS_RAMP_MS of RTC time however long the
+ * Timer0 period is.
+ */
+
+#include <Arduino.h>
+
+#include "RTC.h"
+#include "brightness.h"
+#include "fast_pin.h"
+#include "pins.h"
+#include "print.h"
+#include "timebase.h"
+
+#define DUTY_MAX 4095
+
+// 4095 * (i * 8 / 255)^2.2 for i = 0 - 32 (the last entry is level 255)
+static const uint16_t gamma_table[33] PROGMEM = {
+    0,    2,    9,    23,   43,   70,   104,  146,  196,  254,  320,  394,  477,  569,  670,  780,  899,
+    1027, 1165, 1312, 1469, 1635, 1811, 1997, 2193, 2400, 2616, 2842, 3079, 3326, 3584, 3852, 4095,
+};
+
+static uint8_t user_level = BRIGHTNESS_FULL;  // From brightness_set()
+static bool night = false;
+
+// Perceptual levels with 8 fraction bits; the ISR moves level toward target
+static volatile uint16_t level_q8 = (uint16_t)BRIGHTNESS_FULL << 8;
+static volatile uint16_t target_q8 = (uint16_t)BRIGHTNESS_FULL << 8;
+static volatile uint16_t duty = DUTY_MAX;
+
+#if BRIGHTNESS_RAMP_MS
+static volatile uint16_t from_q8 = (uint16_t)BRIGHTNESS_FULL << 8;  // Where the ramp started
+static volatile uint32_t ramp_start_ms = 0;                         // now_ms() when it started
+#endif
+
+static uint16_t level_to_duty(uint16_t level) {
+    if (level >= (uint16_t)BRIGHTNESS_FULL << 8)
+        return DUTY_MAX;
+    uint8_t i = level >> 11;
+    uint8_t frac = level >> 3;
+    uint16_t lo = pgm_read_word(&gamma_table[i]);
+    uint16_t hi = pgm_read_word(&gamma_table[i + 1]);
+    return lo + (((unsigned long)(hi - lo) * frac) >> 8);
+}
+
+#ifdef __AVR__
+
+static void write_duty(uint16_t d) {
+    static uint8_t error = 0;
+
+    if (d == 0) {
+        TCCR0A &= ~_BV(COM0B1);  // OCR0B = 0 would still give a short pulse
+        return;
+    }
+
+    uint8_t value = d >> 4;
+    error += d & 0x0F;
+    if (error >= 16) {
+        error -= 16;
+        if (value < 255)
+            value++;
+    }
+    OCR0B = value;
+    TCCR0A |= _BV(COM0B1);
+}
+
+#else
+
+static void write_duty(uint16_t d) {
+    static int last = -1;
+    if ((d >> 4) != last) {
+        last = d >> 4;
+        analogWrite(HV_PWM_CONTROL, last);
+    }
+}
+
+#endif
+
+/**
+ * @brief Move the ramp on and set the PWM; call once per Timer0 period
+ */
+void brightness_tick() {
+    uint16_t level = level_q8;
+    uint16_t target = target_q8;
+    if (level != target) {
+#if BRIGHTNESS_RAMP_MS
+        uint32_t elapsed = now_ms() - ramp_start_ms;
+        if (elapsed >= BRIGHTNESS_RAMP_MS)
+            level = target;
+        else
+            level = from_q8 + ((long)target - (long)from_q8) * (long)elapsed / BRIGHTNESS_RAMP_MS;
+#else
+        level = target;
+#endif
+        level_q8 = level;
+        duty = level_to_duty(level);
+    }
+
+    write_duty(duty);
+}
+
+static uint8_t effective_level() {
+    return (night && user_level > NIGHT_DIM_LEVEL) ? NIGHT_DIM_LEVEL : user_level;
+}
+
+// A ramp from the level now, whatever the last one reached
+static void set_target(uint8_t level) {
+#if BRIGHTNESS_RAMP_MS
+    uint32_t now = now_ms();
+#endif
+
+    cli();
+#if BRIGHTNESS_RAMP_MS
+    from_q8 = level_q8;
+    ramp_start_ms = now;
+#endif
+    target_q8 = (uint16_t)level << 8;
+    sei();
+}
+
+void brightness_setup() {
+    fast_pin<HV_PWM_CONTROL>::low();  // The level when the PWM is off
+    fast_pin<HV_PWM_CONTROL>::output();
+    write_duty(duty);  // Start out bright
+}
+
+/**
+ * @brief Ramp to a new level, 0 (off) to BRIGHTNESS_FULL
+ */
+void brightness_set(uint8_t level) {
+    user_level = level;
+    set_target(effective_level());
+}
+
+/**
+ * @brief Go to a level at once, without a ramp; for a level restored at
+ * boot
+ */
+void brightness_restore(uint8_t level) {
+    user_level = level;
+    uint16_t l = (uint16_t)effective_level() << 8;
+    uint16_t d = level_to_duty(l);
+
+    cli();
+    level_q8 = l;
+    target_q8 = l;
+    duty = d;
+    sei();
+}
+
+uint8_t brightness_get() {
+    return user_level;
+}
+
+/**
+ * @brief Dim the tubes overnight; a task that runs every
+ * BRIGHTNESS_POLL_MS
+ */
+void brightness_poll() {
+#if NIGHT_DIM_START != NIGHT_DIM_END
+    uint8_t hour = time_hour();
+#if NIGHT_DIM_START < NIGHT_DIM_END
+    bool is_night = hour >= NIGHT_DIM_START && hour < NIGHT_DIM_END;
+#else
+    bool is_night = hour >= NIGHT_DIM_START || hour < NIGHT_DIM_END;
+#endif
+    if (is_night != night) {
+        night = is_night;
+        DPRINTV("Night dimming %s\n", night ? "on" : "off");
+        set_target(effective_level());
+    }
+#endif
+}
+
+void print_brightness_stats() {
+    cli();
+    uint16_t level = level_q8;
+    uint16_t d = duty;
+    sei();
+    PRINT("Brightness: %u (set %u)%s, duty: %u/%d\n", (uint8_t)(level >> 8), user_level, night ? " night" : "", d,
+          DUTY_MAX);
+}
@@ -0,0 +1,140 @@
+
+/**
+ * @brief The colon on OC1A, blinked by Timer1
+ *
+ * The blink patterns use fast PWM with ICR1 as TOP (mode 14) at clk/256:
+ * a period of 62500 ticks is one second, OC1A is set at BOTTOM and cleared
+ * when the count reaches OCR1A, so OCR1A is how long the colon is on. On
+ * the falling SQW edge the count is set to TOP; the next tick (16us on)
+ * wraps it to BOTTOM and turns the colon on. The timer's crystal and the
+ * RTC differ by tens of ppm, so each second's correction is a few ticks.
+ *
+ * The fade is a ~280Hz PWM (mode 14, clk/64) whose duty is stepped by
+ * the overflow interrupt along a square-law ramp; each SQW edge starts the
+ * next ramp. This is the one pattern that uses the CPU, about 280 short
+ * interrupts a second.
+ */
+
+#include <Arduino.h>
+
+#include "colon.h"
+#include "fast_pin.h"
+#include "pins.h"
+
+#if COLON_TIMER1
+
+#ifndef __AVR__
+#error "The Timer1 colon needs the AVR timer; use COLON_TIMER1=0"
+#endif
+
+#if HV_PS || PROFILE
+#error "The Timer1 colon, the HV supply and the profiler all use Timer1; use COLON_TIMER1=0"
+#endif
+
+#define BLINK_TOP (F_CPU / 256 - 1)  // One second at clk/256
+#define BLINK_ON ((BLINK_TOP + 1) / 2)
+#define FLASH_ON ((BLINK_TOP + 1) / 8)
+
+#define FADE_STEPS 120                           // Overflows in a ramp
+#define FADE_TOP (FADE_STEPS * FADE_STEPS / 16)  // 900: 16MHz / 64 / 901 = 277Hz
+
+static_assert(BLINK_TOP <= 0xFFFF, "One second at clk/256 must fit in Timer1");
+
+static volatile colon_pattern pattern = colon_blink;
+
+static volatile uint8_t fade_step = 0;
+static volatile bool fade_up = true;
+
+/**
+ * @brief Start a pattern; interrupts must be off
+ */
+static void start_pattern(colon_pattern p) {
+    TIMSK1 = 0;
+    TCCR1B = 0;  // Stop the timer while it is changed
+
+    switch (p) {
+    case colon_blink:
+    case colon_flash:
+    case colon_on:
+        ICR1 = BLINK_TOP;
+        OCR1A = p == colon_blink ? BLINK_ON : (p == colon_flash ? FLASH_ON : BLINK_TOP);
+        TCNT1 = BLINK_TOP;  // Wrap on the first tick: load OCR1A and start on
+        TCCR1A = _BV(COM1A1) | _BV(WGM11);
+        TCCR1B = _BV(WGM13) | _BV(WGM12) | _BV(CS12);
+        break;
+
+    case colon_fade:
+        fade_step = 0;
+        fade_up = true;
+        ICR1 = FADE_TOP;
+        OCR1A = 0;
+        TCNT1 = FADE_TOP;
+        TCCR1A = _BV(COM1A1) | _BV(WGM11);
+        TCCR1B = _BV(WGM13) | _BV(WGM12) | _BV(CS11) | _BV(CS10);
+        TIFR1 = _BV(TOV1);
+        TIMSK1 = _BV(TOIE1);
+        break;
+
+    default:
+        TCCR1A = 0;  // OC1A disconnected; the pin is low
+        break;
+    }
+}
+
+void colon_setup() {
+    fast_pin<SEPARATOR>::output();
+    fast_pin<SEPARATOR>::low();
+
+    uint8_t sreg = SREG;
+    cli();
+    start_pattern(pattern);
+    SREG = sreg;
+}
+
+void colon_set_pattern(colon_pattern p) {
+    cli();
+    pattern = p;
+    start_pattern(p);
+    sei();
+}
+
+colon_pattern colon_get_pattern() {
+    return pattern;
+}
+
+/**
+ * @brief Keep the colon in phase with the RTC; call from the SQW ISR on
+ * both edges. 'second' is the falling edge, the start of the second.
+ */
+void colon_sqw_edge(bool second) {
+    switch (pattern) {
+    case colon_blink:
+    case colon_flash:
+    case colon_on:
+        if (second)
+            TCNT1 = BLINK_TOP;
+        break;
+
+    case colon_fade:
+        fade_step = 0;
+        fade_up = second;
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Step the fade; only enabled for colon_fade
+ */
+ISR(TIMER1_OVF_vect) {
+    uint8_t step = fade_step;
+    if (step < FADE_STEPS)
+        fade_step = ++step;
+
+    uint8_t level = fade_up ? step : FADE_STEPS - step;
+    OCR1A = (uint16_t)(level * level) >> 4;  // Buffered; takes effect at TOP
+}
+
+#endif  // COLON_TIMER1
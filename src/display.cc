@@ -0,0 +1,235 @@
+
+/**
+ * @brief The display engine
+ *
+ * There are three frames: the back buffer that loop() writes, the front
+ * buffer the ISR shows and the old frame the ISR fades out. A frame is
+ * DISPLAY_BYTES of packed BCD, already in the form the 595s need.
+ *
+ * display_commit() marks the back buffer ready; the next refresh rotates
+ * the three pointers (old <- front <- back <- old), which is the swap.
+ * loop() does not touch the back buffer until the swap is done, so neither
+ * side ever sees a half-written frame.
+ *
+ * The crossfade is time-sliced: FADE_STEPS refreshes make one cycle and
+ * the new frame is shown for 'fade_level' of them, the old frame for the
+ * rest. fade_level goes from 0 to FADE_STEPS over DISPLAY_FADE_MS. The
+ * chain is only sent when the frame to show changes, so outside a fade
+ * a refresh is a few tests and a return.
+ */
+
+#include <Arduino.h>
+
+#include "display.h"
+#include "print.h"
+#include "profile.h"
+#include "shift_register.h"
+
+static uint8_t frames[3][DISPLAY_BYTES];
+
+// volatile: the ISR rotates these
+static uint8_t *volatile back = frames[0];
+static uint8_t *volatile front = frames[1];
+
+#if DISPLAY_REFRESH_HZ
+
+#ifndef __AVR__
+#error "The display engine needs Timer2; use DISPLAY_REFRESH_HZ=0"
+#endif
+
+#define TIMER2_PRESCALE 64
+#define TIMER2_TOP (F_CPU / TIMER2_PRESCALE / DISPLAY_REFRESH_HZ - 1)
+
+#if TIMER2_TOP < 10 || TIMER2_TOP > 255
+#error "DISPLAY_REFRESH_HZ is out of range for Timer2 (about 980Hz to 25kHz)"
+#endif
+
+#define FADE_STEPS 16  // A power of two
+#define REFRESHES_PER_STEP (DISPLAY_REFRESH_HZ * 1L * DISPLAY_FADE_MS / 1000 / FADE_STEPS)
+
+#if DISPLAY_FADE_MS && (REFRESHES_PER_STEP < 1 || REFRESHES_PER_STEP > 255)
+#error "DISPLAY_FADE_MS is out of range for DISPLAY_REFRESH_HZ"
+#endif
+
+static uint8_t *volatile old = frames[2];
+static volatile bool swap_pending = false;
+
+static uint8_t fade_level = FADE_STEPS;  // FADE_STEPS: not fading
+static uint8_t fade_count = 0;           // refreshes at this fade_level
+static uint8_t slice = 0;
+static const uint8_t *shown = 0;         // the frame in the 595s; 0 to force a send
+
+// CPU load, in Timer2 ticks (4us) spent in the ISR
+static volatile unsigned long refresh_count = 0;
+static volatile unsigned long refresh_ticks = 0;
+static volatile uint8_t refresh_ticks_max = 0;
+
+void display_setup() {
+    shift_register_setup();
+
+    cli();
+    TCCR2A = _BV(WGM21);  // CTC, TOP = OCR2A
+    TCCR2B = _BV(CS22);   // clk/64
+    OCR2A = TIMER2_TOP;
+    TCNT2 = 0;
+    TIMSK2 = _BV(OCIE2A);
+    sei();
+}
+
+static void show(const uint8_t *frame) {
+    // Don't wait on a transfer here: in an ISR the SPI ISR can't finish it.
+    // Try again on the next refresh.
+    if (frame == shown || shift_register_busy())
+        return;
+    updateShiftRegister(frame, DISPLAY_STAGES);
+    shown = frame;
+}
+
+/**
+ * @brief One display refresh; called from the Timer2 ISR
+ */
+void display_refresh() {
+    if (swap_pending) {
+        uint8_t *t = old;
+        old = front;
+        front = back;
+        back = t;
+        // Later display_set_digit() calls change only some digits
+        memcpy(back, front, DISPLAY_BYTES);
+        swap_pending = false;
+        shown = 0;
+#if DISPLAY_FADE_MS
+        fade_level = 0;
+        fade_count = 0;
+#endif
+    }
+
+    if (fade_level < FADE_STEPS) {
+        slice = (slice + 1) & (FADE_STEPS - 1);
+        show(slice < fade_level ? front : old);
+        if (++fade_count == REFRESHES_PER_STEP) {
+            fade_count = 0;
+            fade_level++;
+        }
+    } else {
+        show(front);
+    }
+}
+
+ISR(TIMER2_COMPA_vect) {
+    // Timer2 ticks are 8 Timer1 ticks
+    PROFILE_RECORD(probe_display_latency, TCNT2 * 8);
+
+    display_refresh();
+
+    // The counter was reset at the compare match, so it now holds the
+    // time since then: ISR latency plus the time spent here.
+    uint8_t ticks = TCNT2;
+    refresh_count++;
+    refresh_ticks += ticks;
+    if (ticks > refresh_ticks_max)
+        refresh_ticks_max = ticks;
+}
+
+/**
+ * @brief Print the display refresh rate and the share of the CPU it uses
+ */
+void print_display_stats() {
+    cli();
+    unsigned long count = refresh_count;
+    unsigned long ticks = refresh_ticks;
+    uint8_t ticks_max = refresh_ticks_max;
+    refresh_count = 0;
+    refresh_ticks = 0;
+    refresh_ticks_max = 0;
+    sei();
+
+    // Load in 0.1% units
+    unsigned long load = count ? ticks * 1000 / (count * (TIMER2_TOP + 1)) : 0;
+    PRINT("Display refreshes: %lu, load: %f%%, max: %uus\n", count, print_fixed_point<1>(load),
+          (unsigned int)(ticks_max * (TIMER2_PRESCALE / (F_CPU / 1000000L))));
+}
+
+static void wait_for_swap() {
+    while (swap_pending)
+        ;
+}
+
+/**
+ * @brief Show the back buffer
+ *
+ * The next refresh makes it the front buffer and starts a fade.
+ */
+void display_commit() {
+    // back is not volatile; keep its stores from moving past the flag
+    asm volatile("" ::: "memory");
+    swap_pending = true;
+}
+
+#else  // DISPLAY_REFRESH_HZ == 0
+
+void display_setup() {
+    shift_register_setup();
+}
+
+static void wait_for_swap() {
+}
+
+/**
+ * @brief Show the back buffer; it is sent to the shift registers now
+ */
+void display_commit() {
+    uint8_t *t = front;
+    front = back;
+    back = t;
+    // Later display_set_digit() calls change only some digits
+    memcpy(back, front, DISPLAY_BYTES);
+
+    updateShiftRegister(front, DISPLAY_STAGES);
+}
+
+#endif
+
+// Indexed by the low bit of a slot: the nibble to keep and the shift
+static const uint8_t keep_mask[2] = {0xF0, 0x0F};
+static const uint8_t nibble_scale[2] = {1, 16};
+
+/**
+ * @brief Set digit n (0 is the rightmost) in the back buffer
+ */
+void display_set_digit(uint8_t n, uint8_t value) {
+    uint8_t slot = pgm_read_byte(&display_chain::slots[n]);
+    uint8_t half = slot & 1;
+
+    wait_for_swap();
+    uint8_t &byte = back[slot >> 1];
+    byte = (byte & keep_mask[half]) | (uint8_t)((value & 0x0F) * nibble_scale[half]);
+}
+
+/**
+ * @brief Set digits 2 * pair and 2 * pair + 1 from a BCD byte, such as an
+ * RTC register; the tens digit is the high nibble
+ */
+void display_set_pair(uint8_t pair, uint8_t bcd) {
+    if (display_chain::pairs_aligned) {
+        uint8_t slot = pgm_read_byte(&display_chain::slots[pair * 2]);
+        wait_for_swap();
+        back[slot >> 1] = bcd;
+    } else {
+        display_set_digit(pair * 2, bcd & 0x0F);
+        display_set_digit(pair * 2 + 1, bcd >> 4);
+    }
+}
+
+/**
+ * @brief Get digit n of the frame being shown
+ */
+uint8_t display_digit(uint8_t n) {
+    uint8_t slot = pgm_read_byte(&display_chain::slots[n]);
+
+    uint8_t sreg = SREG;
+    cli();  // front is two bytes and the ISR can change it
+    uint8_t byte = front[slot >> 1];
+    SREG = sreg;
+    return (slot & 1) ? byte >> 4 : byte & 0x0F;
+}
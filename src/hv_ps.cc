@@ -0,0 +1,145 @@
+/**
+ * @brief Code for the PID controller for the HV PS
+ *
+ * Use a PID controller to vary the duty cycle of a 31.25 kHz 5v output
+ * on Pin 10 of an ATmega348 Arduino so that it controls the High Voltage
+ * power supply for the nixies tubes. The PID controller reads the HV PS
+ * voltage via analog pin 0 (via a voltage divider). Each sample is
+ * SAMPLE_PERIOD ticks of oversampled readings; see adc.h.
+ *
+ * The controller used to be the PID_v1 library, polled from loop(): soft
+ * floating point and a millis() call on every pass. Now the ADC runs on
+ * its own and the 1ms tick runs the fixed-point controller on each new
+ * sample and sets the duty cycle.
+ */
+
+#include <Arduino.h>
+
+#include "adc.h"
+#include "fast_pin.h"
+#include "hv_ps.h"
+#include "pid.h"
+#include "pins.h"
+#include "print.h"
+
+#if HV_PS
+
+#ifndef __AVR__
+#error "The HV supply needs Timer1 and the ADC; use HV_PS=0"
+#endif
+
+#if PROFILE
+#error "The HV supply and the profiler both use Timer1; use PROFILE=0"
+#endif
+
+#ifndef PID_DIAGNOSTIC
+#define PID_DIAGNOSTIC 0 // PID timing on Pin 6 if 1. See below.
+#endif
+
+#define PID_DIAGNOSTIC_PIN 6
+
+// The set point, limits and gains are in hv_ps.h
+static pid_controller pid;
+
+/**
+ * @brief Setup the HV power supply
+ * This sets up Timer 1, the 16-bit timer capable of PWN operation.
+ * The PWN signal is output to Pin 10 of the ATmega 348 Arduino.
+ *
+ * @see ATmega48 documentation, p.120, for information about Timer 1
+ */
+void hv_ps_setup() {
+    fast_pin<HV_PS_INPUT>::input();
+    fast_pin<HV_PS_CONTROL>::output();
+#if PID_DIAGNOSTIC
+    fast_pin<PID_DIAGNOSTIC_PIN>::output();
+#endif
+
+    cli();
+
+    TCCR1A = 0; // initialize TCCR1A (Timer/Counter1 Control Register A) to 0
+    TCCR1B = 0; // same for TCCR1B
+    TCNT1 = 0;  // initialize counter value to 0 (Timer Counter 1)
+
+    // Use Timer1 for the HV PS control signal. This is PWM output that
+    // controls the voltage of the power supply (See P.140-3).
+
+    // COM1A (Compare Output Mode for Counter 1, Channel A), control the Output
+    // Compare pin OC1A.
+    // COM1B Same for channel B (which is the channel this code uses).
+
+    // COM1A 1:0 -> 0, 0 -> Normal port operation, OC1A disconnected
+    // COM1B 1:0 -> 1, 0 -> Clear OC1B on Compare Match (Set output to low level).
+
+    // WGM1 (Waveform Generation Mode, Timer/Counter 1) The four bits that control
+    // waveform generation are split between TCCR1A and TCCR1B.
+
+    // To set the timer for 9-bit resolution. WGM1 3:0 -> 0, 1, 1, 0
+    // With 9-bit res. the counter will count to 0x1FF.
+
+    // CS1 (Clock Set, timer/counter 1) CS1 -> 0, 0, 1 -> No pre scaling. This
+    // sets the clock at 62.5 kHz which provides a 31.25 kHz PWM output.
+
+    TCCR1A = _BV(COM1B1) | _BV(WGM11);
+    TCCR1B = _BV(WGM12) | _BV(CS10);
+
+    // OCR1B (Output Compare Register 1 B) is an unsigned 16 bit int.
+
+    OCR1B = HV_PS_INITIAL_OUTPUT; // 9-bit resolution --> 0x0000 - 0x01FF
+
+    sei();
+
+    // Configure the PID controller. It holds the initial duty cycle until
+    // the first sample, then goes to automatic, which is bumpless.
+    pid_init(pid, HV_PS_KP_Q16, HV_PS_KI_Q16, HV_PS_KD_Q16, HV_PS_OUTPUT_MIN, HV_PS_OUTPUT_MAX);
+    pid.setpoint = HV_PS_SET_POINT;
+    pid_set_output(pid, HV_PS_INITIAL_OUTPUT);
+
+    adc_setup(HV_PS_INPUT - A0);
+
+    DPRINT("HV PS up.\n");
+    flush();
+}
+
+/**
+ * @brief compute an iteration of the PID controller for each new sample;
+ * call from the 1ms tick ISR
+ *
+ * The PWM of Timer/Counter 1 is controlled by setting a value in OCR1B
+ * (Output Control Register 1 B). The ISR runs with interrupts off, so
+ * the compiler's two byte write to OCR1B is safe. See p.122.
+ *
+ * PID_DIAGNOSTIC = 1 will toggle pin 6 on the arduino while the PID is
+ * computing.
+ */
+void hv_ps_tick() {
+    uint16_t input;
+    while (adc_read(input)) {
+#if PID_DIAGNOSTIC
+        fast_pin<PID_DIAGNOSTIC_PIN>::high();
+#endif
+
+        if (!pid.automatic)
+            pid_set_automatic(pid, true, input);
+        OCR1B = pid_compute(pid, input);
+
+#if PID_DIAGNOSTIC
+        fast_pin<PID_DIAGNOSTIC_PIN>::low();
+#endif
+    }
+}
+
+/**
+ * @brief Print the rail's telemetry and the controller's output
+ */
+void print_hv_ps_stats() {
+    cli();
+    int16_t output = pid.output;
+    long integral = pid.integral;
+    sei();
+
+    print_adc_stats();
+    PRINT("HV PS: set %d, output: %d/511, integral: %ld\n", HV_PS_SET_POINT, output, integral >> 16);
+}
+
+#endif  // HV_PS
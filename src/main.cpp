@@ -3,93 +3,123 @@
 #include <PinChangeInterrupt.h>
 
 #include "RTC.h"
+#include "brightness.h"
+#include "colon.h"
+#include "display.h"
+#include "fast_pin.h"
+#include "hv_ps.h"
 #include "mode_switch.h"
 #include "print.h"
 #include "pins.h"
+#include "power.h"
+#include "profile.h"
+#include "ram.h"
+#include "reset.h"
+#include "scheduler.h"
+#include "serial_cmd.h"
+#include "settings.h"
+#include "tick.h"
+#include "watchdog.h"
 
 #define BAUD_RATE 115200
 
-// BCD for 0, ..., 9 for the LSD, MSD.
-uint8_t LSD[10] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09};
-uint8_t MSD[10] = {0x00, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0x90};
-
-/*
- * updateShiftRegister() - This function sets the REGISTER_CLK pin to low,
- * then calls the Arduino function 'shiftOut' to shift out contents
- * of variable 'data' in the shift register before putting 'REGISTER_CLK' high again.
- *
- * On a scope, it appears that the SERIAL_DATA pin is left high or low depending
- * on the last bit value written. I set it LOW so that every call has the
- * same initial condition, although I'm not sure that difference matters to
- * the 595 chips.
- *
- * I switched to this code over the ShiftRegister74HC595 library because I was
- * getting an odd error where sometimes the values ouput were corrupted. The
- * problem might have been noise on the breadboard or it might have been an
- * issue with interrupts. NB: It was noise; the HV PS that used the PID controller
- * was noisy and that was fixed by using a better HV PS. That also meant tha
- * the PID controller could be dumped.
- */
-void updateShiftRegister(uint8_t data) {
-    digitalWrite(REGISTER_CLK, LOW);
-    shiftOut(SERIAL_DATA, SERIAL_CLK, MSBFIRST, data);
-    digitalWrite(REGISTER_CLK, HIGH);
-    digitalWrite(SERIAL_DATA, LOW);
+// HardwareSerial owns the receive interrupt, so the serial task can't be
+// posted; it looks for commands on each 1ms tick instead
+#define SERIAL_POLL_MS 1
+
+static void time_task() {
+    if (time_update_handler())
+        display_commit();
+}
+
+static void switch_task() {
+    if (process_input_switch_press())
+        display_commit();
 }
 
+// After a brownout, watchdog or reset button the time is shown at once;
+// the random digits are only for a power-on. See reset.h.
 void setup() {
+    bool cold = reset_cold();
+
     Serial.begin(BAUD_RATE);
-    DPRINT("boot\n");
+    DPRINTV("boot, reset 0x%02x\n", reset_flags());
     flush();
 
+    settings_setup();
     RTC_setup();
+#if COLON_TIMER1
+    colon_set_pattern((colon_pattern)(settings_get().colon % colon_pattern_count));
+#endif
+
+#if HV_PS
+    hv_ps_setup();
+#endif
+
+    display_setup();
+
+    power_setup();
+
+#if PROFILE
+    profile_setup();
+#endif
+
+    fast_pin<LED_BUILTIN>::output();
+    brightness_setup();
+    input_switch_setup();
+    tick_setup();
+
+    sched_add(task_time, time_task, 0);
+    sched_add(task_switch, switch_task, 0);
+    sched_add(task_serial, serial_cmd_poll, SERIAL_POLL_MS);
+    sched_add(task_log, log_drain, 0);
+    sched_add(task_brightness, brightness_poll, BRIGHTNESS_POLL_MS);
+#if RAM_CHECK
+    sched_add(task_ram, ram_poll, RAM_CHECK_INTERVAL);
+#endif
+    sched_add(task_settings, settings_task, 0);
+
+    if (cold) {
+        fast_pin<LED_BUILTIN>::high();
+
+        // Flash random digits at start up.
+        int digit_time_ms = 50;
+        int random_time_ms = 1000;
+        do {
+            for (uint8_t i = 0; i < DISPLAY_DIGITS; ++i)
+                display_set_digit(i, random(10));
+            display_commit();
+
+            delay(digit_time_ms);
+            random_time_ms -= digit_time_ms;
+        } while (random_time_ms > 0);
+
+        fast_pin<LED_BUILTIN>::low();
+    }
+
+    // The time read by RTC_setup(); the time task keeps it from here
+    update_display_with_time();
+    display_commit();
 
-    pinMode(REGISTER_CLK, OUTPUT);
-    pinMode(SERIAL_CLK, OUTPUT);
-    pinMode(SERIAL_DATA, OUTPUT);
-
-    pinMode(LED_BUILTIN, OUTPUT);
-    pinMode(HV_PWM_CONTROL, OUTPUT);
-    pinMode(INPUT_SWITCH, INPUT);
-
-    attachInterrupt(digitalPinToInterrupt(INPUT_SWITCH), input_switch_push, RISING);
-
-    digitalWrite(LED_BUILTIN, HIGH);
-    digitalWrite(HV_PWM_CONTROL, HIGH);  // Start out bright
-
-    // Flash random digits at start up.
-    int digit_time_ms = 50;
-    int random_time_ms = 1000;
-    do {
-        uint8_t bits[2];
-        bits[0] = MSD[random(10)] | LSD[random(10)];
-        bits[1] = MSD[random(10)] | LSD[random(10)];
-
-        cli();
-        updateShiftRegister(bits[1]);
-        updateShiftRegister(bits[0]);
-        sei();
-    
-        delay(digit_time_ms);
-        random_time_ms -= digit_time_ms;
-    } while (random_time_ms > 0);
-
-    digitalWrite(LED_BUILTIN, LOW);
+#if WATCHDOG
+    watchdog_setup();  // Last, so the start up does not count against it
+#endif
 }
 
 void loop() {
-    uint8_t bits[2]; // 1 is the LSD pair, 0 the MSD pair
-
-    // hv_ps_adjust();
-
-    if (time_update_handler()) {
-        bits[0] = MSD[digit_3] | LSD[digit_2];
-        bits[1] = MSD[digit_1] | LSD[digit_0];
-        // I don't know for sure that these calls are needed. They seem to
-        // do no harm.
-        cli();
-        updateShiftRegister(bits[1]);
-        updateShiftRegister(bits[0]);
-        sei();
+    // The tasks put new digits in the display's back buffer. No
+    // cli()/sei() here: the display ISR (or, without it, the shift register
+    // code) is the only thing that touches the 595s.
+    {
+        PROFILE_SCOPE(probe_loop);  // Everything but the sleep
+#if WATCHDOG
+        unsigned long start = micros();
+        sched_run();
+        watchdog_feed(micros() - start);
+#else
+        sched_run();
+#endif
     }
+
+    power_idle();
 }
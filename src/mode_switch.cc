@@ -3,128 +3,189 @@
 
 #include <Arduino.h>
 
+#include "RTC.h"
+#include "brightness.h"
+#include "fast_pin.h"
 #include "print.h"
+#include "profile.h"
 #include "pins.h"
+#include "scheduler.h"
+#include "settings.h"
+#include "timebase.h"
 
-#define SWITCH_INTERVAL 150     // ms
+#define SWITCH_DEBOUNCE 20      // samples (about 1ms each) the switch must be steady
 #define SWITCH_PRESS_2S 2000    // 2 Seconds
 #define SWITCH_PRESS_5S 5000    // 5 S
-#define SWITCH_PRESS_10S 10000  // 10 S
 
-volatile unsigned long input_switch_down_time = 0;
-volatile enum switch_press_duration input_switch_press = none;
+#define SWITCH_EVENTS 8         // A power of two
+#define DATE_DISPLAY_MS 3000    // How long a medium press shows the date
 
-// Set using an interrupt; see mode_switch.cc/h
-volatile int brightness = 0;
+// The events from input_switch_sample() (the producer, in an ISR) to
+// process_input_switch_press() (the consumer, a task). Each side only
+// writes its own index, so no locks are needed.
+static switch_event events[SWITCH_EVENTS];
+static volatile uint8_t events_head = 0;
+static volatile uint8_t events_tail = 0;
+static volatile unsigned int events_dropped = 0;
 
+// Set using the switch; see input_switch_quick_press()
+static uint8_t brightness = 0;
+
+// The old analogWrite() values 255, 128, 76, 24 and 0 on the gamma curve.
 // 100 provides about 1mA average to each tube
-const int brightness_count[] = {255, 128, 76, 24, 0};
+static const uint8_t brightness_levels[] = {BRIGHTNESS_FULL, 186, 147, 87, 0};
 
-#if 0
-/**
- * Return true if the input switch was pressed and released.
- *
- * This does not change the state of the input switch state variables.
- */
-bool poll_input_button() {
-#if DEBUG
-    static enum switch_press_duration last_press = none;
-    if (last_press != input_switch_press) {
-        print("Input switch state: %d\n", input_switch_press);
-        last_press = input_switch_press;
+#define BRIGHTNESS_STEPS (sizeof(brightness_levels) / sizeof(brightness_levels[0]))
+
+static void set_brightness(uint8_t step) {
+    brightness = step;
+    brightness_set(brightness_levels[brightness]);
+
+    settings s = settings_get();
+    s.brightness = brightness;
+    settings_save(s);
+}
+
+// Stamped with now_ms(), RTC time; debouncing and the press lengths use
+// millis(), which is cheaper and plenty for those
+static void push_event(uint8_t type, uint8_t duration) {
+    uint8_t next = (events_head + 1) & (SWITCH_EVENTS - 1);
+    if (next == events_tail) {
+        events_dropped++;
+        return;
     }
-#endif
-    return input_switch_press != none;
+    switch_event &e = events[events_head];
+    e.type = type;
+    e.duration = duration;
+    e.time_ms = now_ms();
+    events_head = next;
+    sched_post(task_switch);
 }
 
-// Faster reads than digitalRead(INPUT_SWITCH)
-inline bool input_switch_held_down() {
-    return PIND & _BV(INPUT_SWITCH_PORT);  // INPUT_SWITCH_PORT --> 3
+static bool pop_event(switch_event &e) {
+    uint8_t tail = events_tail;
+    if (tail == events_head)
+        return false;
+    e = events[tail];
+    events_tail = (tail + 1) & (SWITCH_EVENTS - 1);
+    return true;
 }
-#endif
 
 /**
- * Get the state of the input switch.
+ * @brief Sample and debounce the switch; call about once a millisecond
+ *
+ * The switch reads HIGH when pressed. A change counts once the new level
+ * has been read SWITCH_DEBOUNCE times in a row, so the time spent here is
+ * the same for every call, bounce or not.
  */
-enum switch_press_duration get_input_button() {
-    return input_switch_press;
+void input_switch_sample() {
+    PROFILE_SCOPE(probe_switch_isr);
+
+    static bool pressed = false;
+    static uint8_t count = 0;
+    static unsigned long down_time = 0;
+    static uint8_t held = none;  // The last switch_held event sent
+
+    bool level = fast_pin<INPUT_SWITCH>::read();
+    unsigned long now = millis();
+
+    if (level == pressed) {
+        count = 0;
+    } else if (++count >= SWITCH_DEBOUNCE) {
+        count = 0;
+        pressed = level;
+        if (pressed) {
+            fast_pin<LED_BUILTIN>::high();
+            down_time = now;
+            held = none;
+            push_event(switch_pressed, none);
+        } else {
+            fast_pin<LED_BUILTIN>::low();
+            unsigned long duration = now - down_time;
+            uint8_t press = quick;
+            if (duration > SWITCH_PRESS_5S)
+                press = long_5s;
+            else if (duration > SWITCH_PRESS_2S)
+                press = medium_2s;
+            push_event(switch_released, press);
+        }
+    }
+
+    if (pressed && held != long_5s) {
+        unsigned long duration = now - down_time;
+        uint8_t press = duration > SWITCH_PRESS_5S ? long_5s : (duration > SWITCH_PRESS_2S ? medium_2s : none);
+        if (press != held) {
+            held = press;
+            push_event(switch_held, press);
+        }
+    }
 }
 
-/**
- * Reset the input button state
- */
-void reset_input_button() {
-    input_switch_press = none;
+// input_switch_sample() runs from the 1ms tick; see tick.cc. The
+// brightness step comes from the settings; call after brightness_setup()
+void input_switch_setup() {
+    fast_pin<INPUT_SWITCH>::input();
+
+    uint8_t step = settings_get().brightness;
+    brightness = step < BRIGHTNESS_STEPS ? step : 0;
+    brightness_restore(brightness_levels[brightness]);
 }
 
 void input_switch_quick_press() {
-    brightness = (brightness == sizeof(brightness_count)/sizeof(brightness_count[0]) - 1) ? 0 : brightness + 1;
+    set_brightness(brightness == BRIGHTNESS_STEPS - 1 ? 0 : brightness + 1);
     DPRINTV("brightness: %d\n", brightness);
-    analogWrite(HV_PWM_CONTROL, brightness_count[brightness]);
+}
+
+void input_switch_medium_press() {
+    show_date(DATE_DISPLAY_MS);
+}
+
+void input_switch_long_press() {
+    set_brightness(0);
+    DPRINT("brightness: reset\n");
 }
 
 /**
- * Assume that poll_input_switch() returns true.
+ * @brief Act on the switch events; the switch task, posted for each event
+ *
+ * A quick press steps the brightness, a 2s press shows the date and a 5s
+ * press puts the brightness back to full.
  *
- * Use the various input switch and input state to perform the correct
- * action. Then reset the input switch state to none.
+ * @return true if the display's back buffer was changed
  */
-void process_input_switch_press() {
-    switch (get_input_button()) {
-        case none:
-            return;
-        case long_5s:
-        case medium_2s:
-            break;
+bool process_input_switch_press() {
+    bool display_changed = false;
+    switch_event e;
+    while (pop_event(e)) {
+        if (e.type != switch_released) {
+            DPRINTV("switch %s %d at %lu\n", e.type == switch_pressed ? "down" : "held", e.duration, e.time_ms);
+            continue;
+        }
+
+        switch (e.duration) {
         case quick:
             input_switch_quick_press();
             break;
-    }
-    reset_input_button();
-}
-
-// These two IRQ handlers for the input switch share state information about
-// the time the switch was pressed, duration of the press and if the switch
-// is currently pressed or has been released.
-//
-// input_switch_press & input_switch_released describe the state of the button
-// input_switch_time is the time in ms that the switch was pressed
-// input_switch_duration is the time span between press and release
-//
-void input_switch_push() {
-    static unsigned long last_interrupt_time = 0;
-    unsigned long now = millis();
-
-    if (now - last_interrupt_time > SWITCH_INTERVAL) {
-        digitalWrite(LED_BUILTIN, HIGH);
-        input_switch_down_time = now;  // Use this to tell how long it has been held down
-        input_switch_press = none;     // This is set when the switch is released
-        attachInterrupt(digitalPinToInterrupt(INPUT_SWITCH), input_switch_release, FALLING);
-    }
-
-    last_interrupt_time = now;
-}
-
-void input_switch_release() {
-    static unsigned long last_interrupt_time = 0;
-    unsigned long now = millis();
-
-    if (now - last_interrupt_time > SWITCH_INTERVAL) {
-        digitalWrite(LED_BUILTIN, LOW);
-        unsigned long input_switch_duration = now - input_switch_down_time;
-        input_switch_down_time = now;  // TODO Needed?
-        attachInterrupt(digitalPinToInterrupt(INPUT_SWITCH), input_switch_push, RISING);
-
-        if (input_switch_duration > SWITCH_PRESS_5S) {
-            input_switch_press = long_5s;
-        } else if (input_switch_duration > SWITCH_PRESS_2S) {
-            input_switch_press = medium_2s;
-        } else {
-            input_switch_press = quick;
+        case medium_2s:
+            input_switch_medium_press();
+            display_changed = true;
+            break;
+        case long_5s:
+            input_switch_long_press();
+            break;
         }
+    }
 
-        process_input_switch_press();
+#if DEBUG
+    static unsigned int dropped_reported = 0;
+    cli();
+    unsigned int dropped = events_dropped;
+    sei();
+    if (dropped != dropped_reported) {
+        dropped_reported = dropped;
+        DPRINTV("switch events dropped: %u\n", dropped);
     }
+#endif
 
-    last_interrupt_time = now;
+    return display_changed;
 }
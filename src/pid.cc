@@ -0,0 +1,82 @@
+
+/**
+ * @brief The fixed-point PID controller
+ *
+ * Each step is three 32-bit multiplies and some adds; on the ATmega328P
+ * that is a few hundred cycles where the floating point version took
+ * thousands. The sum must fit in 32 bits: with a 10-bit ADC the error
+ * and the change in the input are at most 1023 counts, so kp and kd must
+ * be less than 8 (and less again for oversampled inputs).
+ */
+
+#include <Arduino.h>
+
+#include "pid.h"
+
+static int32_t clamp(int32_t value, int16_t low, int16_t high) {
+    if (value > ((int32_t)high << 16))
+        return (int32_t)high << 16;
+    if (value < ((int32_t)low << 16))
+        return (int32_t)low << 16;
+    return value;
+}
+
+void pid_init(pid_controller &pid, int32_t kp, int32_t ki, int32_t kd, int16_t out_min, int16_t out_max) {
+    pid.kp = kp;
+    pid.ki = ki;
+    pid.kd = kd;
+    pid.out_min = out_min;
+    pid.out_max = out_max;
+    pid.setpoint = 0;
+    pid.last_input = 0;
+    pid.output = out_min;
+    pid.integral = (int32_t)out_min << 16;
+    pid.automatic = false;
+}
+
+/**
+ * @brief Set the output by hand; only used while the controller is off
+ */
+void pid_set_output(pid_controller &pid, int16_t output) {
+    if (output > pid.out_max)
+        output = pid.out_max;
+    else if (output < pid.out_min)
+        output = pid.out_min;
+    pid.output = output;
+}
+
+/**
+ * @brief Turn the controller on or off
+ *
+ * Turning it on is bumpless: the integral starts at the current output
+ * and the derivative at the current input, so the output does not jump.
+ */
+void pid_set_automatic(pid_controller &pid, bool automatic, int16_t input) {
+    if (automatic && !pid.automatic) {
+        pid.integral = clamp((int32_t)pid.output << 16, pid.out_min, pid.out_max);
+        pid.last_input = input;
+    }
+    pid.automatic = automatic;
+}
+
+/**
+ * @brief Run one sample period of the controller
+ *
+ * @return The new output; while the controller is off, the output set
+ * with pid_set_output()
+ */
+int16_t pid_compute(pid_controller &pid, int16_t input) {
+    if (!pid.automatic)
+        return pid.output;
+
+    int16_t error = pid.setpoint - input;
+    int16_t change = input - pid.last_input;
+    pid.last_input = input;
+
+    // Anti-windup: the integral alone never goes past the output limits
+    pid.integral = clamp(pid.integral + pid.ki * error, pid.out_min, pid.out_max);
+
+    int32_t output = clamp(pid.kp * error + pid.integral - pid.kd * change, pid.out_min, pid.out_max);
+    pid.output = (output + 0x8000) >> 16;
+    return pid.output;
+}
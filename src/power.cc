@@ -0,0 +1,141 @@
+
+/**
+ * @brief Power management
+ *
+ * The clock only has work twice a second (the SQW edges) and when the
+ * switch is pressed, so between those the CPU sleeps. Power-save and the
+ * deeper modes stop clk_io, which stops the timers and with them millis()
+ * and the PWMs, so this uses idle mode. Timer0 overflows every 1.024ms and
+ * wakes the CPU, which goes back to sleep once loop() finds nothing to do.
+ *
+ * Peripherals the clock does not use are turned off in power_setup().
+ *
+ * With POWER_STATS set, the time spent asleep is measured with micros() and
+ * the awake share is printed every POWER_STATS seconds. The ISR that ends a
+ * sleep runs before micros() is read, so its time counts as asleep.
+ */
+
+#include <Arduino.h>
+
+#include "colon.h"
+#include "display.h"
+#include "hv_ps.h"
+#include "pins.h"
+#include "power.h"
+#include "print.h"
+#include "profile.h"
+#include "scheduler.h"
+
+#if POWER_SAVE
+
+#ifndef __AVR__
+#error "POWER_SAVE needs the AVR sleep modes; use POWER_SAVE=0"
+#endif
+
+#include <avr/power.h>
+#include <avr/sleep.h>
+
+#if POWER_STATS
+static unsigned long stats_start_ms = 0;
+static unsigned long stats_start_us = 0;
+static unsigned long asleep_us = 0;
+static unsigned long wakeups = 0;
+#endif
+
+void power_setup() {
+    // The ADC (unless it reads the HV supply), the digital input buffers
+    // on A0 - A3 and the comparator. A4/A5 are the TWI pins.
+#if !HV_PS
+    ADCSRA &= ~_BV(ADEN);
+    power_adc_disable();
+#endif
+    DIDR0 = _BV(ADC0D) | _BV(ADC1D) | _BV(ADC2D) | _BV(ADC3D);
+    ACSR = _BV(ACD);
+
+    // Timer1 is free unless it drives the colon or the HV supply, or the
+    // profiler is built in
+#if !PROFILE && !HV_PS && !COLON_TIMER1
+    power_timer1_disable();
+#endif
+
+#if !DISPLAY_REFRESH_HZ
+    power_timer2_disable();
+#endif
+
+#if SHIFT_REGISTER_TRANSPORT != SHIFT_OUT_SPI
+    power_spi_disable();
+#endif
+
+    // Timer0 (millis(), HV_PWM_CONTROL), the TWI and the USART stay on
+
+#if POWER_STATS
+    stats_start_ms = millis();
+    stats_start_us = micros();
+#endif
+}
+
+/**
+ * @brief Sleep until the next interrupt, unless there is work to do
+ *
+ * The test for work and the sleep are done with interrupts off, and sei()
+ * lets one more instruction (the sleep) run before any interrupt, so an
+ * ISR that sets a flag after the test still wakes the CPU.
+ */
+void power_idle() {
+    set_sleep_mode(SLEEP_MODE_IDLE);
+
+    cli();
+    if (sched_ready()) {
+        sei();
+        return;
+    }
+
+    sleep_enable();
+#if POWER_STATS
+    unsigned long start = micros();
+#endif
+    sei();
+    sleep_cpu();
+    sleep_disable();
+
+#if POWER_STATS
+    asleep_us += micros() - start;
+    wakeups++;
+
+    if (millis() - stats_start_ms >= POWER_STATS * 1000UL)
+        print_power_stats();
+#endif
+}
+
+#if POWER_STATS
+/**
+ * @brief Print the share of time awake and the number of wakeups, then
+ * start a new measurement
+ */
+void print_power_stats() {
+    unsigned long now_us = micros();
+    unsigned long elapsed_ms = (now_us - stats_start_us) / 1000;
+    if (elapsed_ms == 0)
+        return;
+
+    // Awake in 0.1% units
+    unsigned long awake_ms = elapsed_ms - asleep_us / 1000;
+    unsigned long awake = awake_ms * 1000 / elapsed_ms;
+    PRINT("Awake: %f%%, wakeups: %lu/s\n", print_fixed_point<1>(awake), wakeups * 1000 / elapsed_ms);
+
+    stats_start_ms = millis();
+    stats_start_us = micros();
+    asleep_us = 0;
+    wakeups = 0;
+}
+#endif
+
+#else  // POWER_SAVE == 0
+
+void power_setup() {
+}
+
+void power_idle() {
+}
+
+#endif
@@ -3,48 +3,287 @@
  * A version of printf for the Arduino.
  * 11/20/22
  * James Gallagher <jhrg@mac.com>
+ *
+ * Output goes to a ring buffer, not to Serial, so PRINT() never waits on
+ * the UART and can be called from an ISR. log_drain(), the log task,
+ * moves what the UART has room for from the ring to Serial. A message that
+ * does not fit in the ring is dropped whole and counted.
+ *
+ * The formatter reads the format from flash a byte at a time and writes
+ * the text into the ring as it goes; there is no message buffer and no
+ * vsnprintf(). The arguments' types were checked when the call was
+ * compiled, so it does not check them again.
+ *
+ * HardwareSerial owns the UART data register empty interrupt, so the ring
+ * is drained from a task rather than from that ISR.
  */
 
 #include <Arduino.h>
 
+#include "print.h"
+#include "scheduler.h"
+
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 128
+#endif
+
+#define LOG_MASK (LOG_BUFFER_SIZE - 1)
+
+#if (LOG_BUFFER_SIZE & LOG_MASK) || LOG_BUFFER_SIZE > 256
+#error "LOG_BUFFER_SIZE must be a power of two, 256 or less"
+#endif
+
+static char ring[LOG_BUFFER_SIZE];
+static volatile uint8_t head = 0;  // Next free byte; moved by print_format()
+static volatile uint8_t tail = 0;  // Next byte to send; moved by log_drain()
+
+static volatile unsigned int log_dropped = 0;
+static unsigned int log_dropped_reported = 0;
+static uint8_t log_high_water = 0;
+
+// The message being formatted goes into the ring from head on, but head
+// is only moved once it is complete
+static volatile bool writing = false;
+static uint8_t cursor;
+static uint8_t space;
+static bool overflow;
+
+static const uint32_t powers_of_ten[] PROGMEM = {1000000000, 100000000, 10000000, 1000000, 100000,
+                                                 10000,      1000,      100,      10,      1};
+
+#define POWERS (sizeof(powers_of_ten) / sizeof(powers_of_ten[0]))
+
+static void put(char c) {
+    if (space == 0) {
+        overflow = true;
+        return;
+    }
+    ring[cursor] = c;
+    cursor = (cursor + 1) & LOG_MASK;
+    space--;
+}
+
+static void pad(uint8_t n, char c) {
+    while (n-- > 0)
+        put(c);
+}
+
+// The digits of n: subtracting powers of ten is much faster than dividing
+// on the AVR. A point goes before the last 'places' digits.
+static void put_decimal(unsigned long n, uint8_t digits, uint8_t places) {
+    for (uint8_t i = POWERS - digits; i < POWERS; ++i) {
+        unsigned long power = pgm_read_dword(&powers_of_ten[i]);
+        char d = '0';
+        while (n >= power) {
+            n -= power;
+            d++;
+        }
+        put(d);
+        if (places && i == POWERS - 1 - places)
+            put('.');
+    }
+}
+
+static void put_hex(unsigned long n, uint8_t digits) {
+    while (digits-- > 0) {
+        uint8_t x = (n >> (4 * digits)) & 0xF;
+        put(x < 10 ? '0' + x : 'a' + x - 10);
+    }
+}
+
+struct spec {
+    bool left;  // '-'
+    bool zero;  // '0'
+    uint8_t width;
+};
+
+static void put_number(const spec &s, unsigned long n, bool negative, uint8_t places, bool hex) {
+    uint8_t digits = 1;
+    if (hex) {
+        while (digits < 8 && (n >> (4 * digits)))
+            digits++;
+    } else {
+        digits = POWERS;
+        while (digits > places + 1 && n < pgm_read_dword(&powers_of_ten[POWERS - digits]))
+            digits--;
+    }
+
+    uint8_t length = digits + (places ? 1 : 0) + (negative ? 1 : 0);
+    uint8_t fill = s.width > length ? s.width - length : 0;
+
+    if (!s.left && !s.zero)
+        pad(fill, ' ');
+    if (negative)
+        put('-');
+    if (!s.left && s.zero)
+        pad(fill, '0');
+    if (hex)
+        put_hex(n, digits);
+    else
+        put_decimal(n, digits, places);
+    if (s.left)
+        pad(fill, ' ');
+}
+
+static void put_string(const spec &s, const char *str, bool flash) {
+    uint8_t fill = 0;
+    if (s.width) {
+        size_t length = flash ? strlen_P(str) : strlen(str);
+        fill = s.width > length ? s.width - length : 0;
+    }
+
+    if (!s.left)
+        pad(fill, ' ');
+    for (char c; (c = flash ? pgm_read_byte(str) : *str) != '\0'; ++str)
+        put(c);
+    if (s.left)
+        pad(fill, ' ');
+}
+
 /**
- * @brief A printf() clone
+ * @brief Format a message into the ring, or drop it if there is not room
  *
- * Use sprintf to format data for printing and pass the resulting string to
- * Arduino Serial.print(). Does not print a newline, so include that in 'fmt.'
- * 
- * @note The printf family on the Atmel 328 processors does not support float
- * or double values without rebuilding one of the libraries. Use %d and round()
- * or break the float into two parts.
+ * Use PRINT(), which checks the format against the arguments; see print.h.
+ * The message is written straight into the free part of the ring with
+ * interrupts on and added to the ring with a store to head once it is
+ * complete, so it is never seen half written. A message that does not fit
+ * is dropped whole and counted. This does not block and is safe to call
+ * from an ISR, but a message from an ISR that interrupts another message
+ * is dropped.
  *
- * @param fmt A sprintf format string
- * @param ... Variadic arguments matching fmt
- * @return void
+ * @param fmt The format, in flash
+ * @param args The arguments, one per conversion
  */
-void print(const char *fmt, ...) {
-    char msg[128];
-    va_list ap;
-    va_start(ap, fmt);
-    vsnprintf(msg, sizeof(msg), fmt, ap); // copies args
-    va_end(ap);
+void print_format(const char *fmt, const print_arg *args) {
+    uint8_t sreg = SREG;
+    cli();
+    if (writing) {
+        log_dropped++;
+        SREG = sreg;
+        return;
+    }
+    writing = true;
+    cursor = head;
+    space = LOG_MASK - ((cursor - tail) & LOG_MASK);
+    SREG = sreg;
+
+    overflow = false;
+    for (char c; !overflow && (c = pgm_read_byte(fmt++)) != '\0';) {
+        if (c != '%') {
+            put(c);
+            continue;
+        }
+
+        c = pgm_read_byte(fmt++);
+        if (c == '%') {
+            put(c);
+            continue;
+        }
+
+        spec s = {false, false, 0};
+        for (;; c = pgm_read_byte(fmt++)) {
+            if (c == '-')
+                s.left = true;
+            else if (c == '0' && s.width == 0)
+                s.zero = true;
+            else if (c >= '0' && c <= '9')
+                s.width = s.width * 10 + c - '0';
+            else
+                break;
+        }
+
+        bool is_long = c == 'l';
+        if (is_long)
+            c = pgm_read_byte(fmt++);
+
+        const print_arg &a = *args++;
+        switch (c) {
+        case 'd': {
+            long n = is_long ? (int32_t)a.n : (int)a.n;
+            put_number(s, n < 0 ? -(unsigned long)n : n, n < 0, 0, false);
+            break;
+        }
+        case 'u':
+        case 'x':
+            put_number(s, is_long ? (uint32_t)a.n : (unsigned int)a.n, false, 0, c == 'x');
+            break;
+        case 'f':
+            put_number(s, a.n < 0 ? -(unsigned long)a.n : a.n, a.n < 0, a.places, false);
+            break;
+        case 'c':
+            pad(s.width > 1 && !s.left ? s.width - 1 : 0, ' ');
+            put((char)a.n);
+            pad(s.width > 1 && s.left ? s.width - 1 : 0, ' ');
+            break;
+        case 's':
+        case 'S':
+            put_string(s, a.s, c == 'S');
+            break;
+        }
+    }
 
-    Serial.print(msg);
+    cli();
+    if (overflow) {
+        log_dropped++;
+    } else {
+        uint8_t used = (cursor - tail) & LOG_MASK;
+        if (used > log_high_water)
+            log_high_water = used;
+        head = cursor;
+    }
+    writing = false;
+    SREG = sreg;
+
+    sched_post(task_log);
 }
 
-void print(const __FlashStringHelper *flash_fmt, ...) {
-    // Copy the string from flash to RAM for use with vsnprintf()
-    char fmt[128];
-    strncpy_P(fmt, (const char *)flash_fmt, sizeof(fmt));
+/**
+ * @brief Send as much of the ring as the UART has room for; the log task
+ *
+ * PRINT() posts the task. While the UART is full it posts itself, so it
+ * runs again on the next pass of loop(). Once the ring is empty, report
+ * any messages dropped since the last report.
+ */
+void log_drain() {
+    int room = Serial.availableForWrite();
+    uint8_t t = tail;
+    while (room-- > 0 && t != head) {
+        Serial.write(ring[t]);
+        t = (t + 1) & LOG_MASK;
+    }
+    tail = t;
+
+    if (t != head) {
+        sched_post(task_log);
+    } else {
+        cli();
+        unsigned int dropped = log_dropped;
+        sei();
+        if (dropped != log_dropped_reported) {
+            PRINT("Log: %u messages dropped\n", dropped - log_dropped_reported);
+            log_dropped_reported = dropped;
+        }
+    }
+}
 
-    va_list ap;
-    va_start(ap, flash_fmt);
-    char msg[128];
-    vsnprintf(msg, sizeof(msg), fmt, ap); // copies args
-    va_end(ap);
+bool log_pending() {
+    return tail != head;
+}
 
-    Serial.print(msg);
+void print_log_stats() {
+    cli();
+    unsigned int dropped = log_dropped;
+    sei();
+    PRINT("Log: %u/%d bytes max, %u dropped\n", log_high_water, LOG_BUFFER_SIZE - 1, dropped);
 }
 
+/**
+ * @brief Send everything in the ring and wait for the UART to finish
+ */
 void flush() {
+    while (tail != head) {
+        Serial.write(ring[tail]);
+        tail = (tail + 1) & LOG_MASK;
+    }
     Serial.flush();
-}
\ No newline at end of file
+}
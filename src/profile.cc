@@ -0,0 +1,107 @@
+
+/**
+ * @brief The profiler's statistics and the dump
+ *
+ * Timer1 runs free at clk/8. Each probe keeps a count, sum, min and max
+ * of its times and a histogram with one bucket per power of two ticks.
+ * Everything is in fixed RAM, about 40 bytes a probe.
+ *
+ * profile_record() can be called from an ISR. It restores the interrupt
+ * state it was called with.
+ */
+
+#include <Arduino.h>
+
+#include "print.h"
+#include "profile.h"
+
+#if PROFILE
+
+#define PROFILE_BUCKETS 12  // the last bucket is 2^11 ticks (1ms) and up
+
+struct profile_stats {
+    unsigned long count;
+    unsigned long sum;
+    uint16_t min;
+    uint16_t max;
+    uint16_t histogram[PROFILE_BUCKETS];
+};
+
+static profile_stats stats[probe_count];
+
+static const char probe_names[probe_count][16] PROGMEM = {
+    "loop", "time update", "shift register", "SQW ISR", "switch ISR", "display latency",
+};
+
+static void profile_reset(profile_stats &s) {
+    memset(&s, 0, sizeof(s));
+    s.min = 0xFFFF;
+}
+
+void profile_setup() {
+    for (uint8_t i = 0; i < probe_count; ++i)
+        profile_reset(stats[i]);
+
+    // Normal mode, clk/8. This replaces the core's PWM setup for Timer1;
+    // nothing here uses analogWrite() on pins 9 or 10.
+    TCCR1A = 0;
+    TCCR1B = _BV(CS11);
+    TIMSK1 = 0;
+}
+
+void profile_record(profile_probe probe, uint16_t ticks) {
+    uint8_t bucket = 0;
+    for (uint16_t t = ticks >> 1; t && bucket < PROFILE_BUCKETS - 1; t >>= 1)
+        bucket++;
+
+    uint8_t sreg = SREG;
+    cli();
+    profile_stats &s = stats[probe];
+    s.count++;
+    s.sum += ticks;
+    if (ticks < s.min)
+        s.min = ticks;
+    if (ticks > s.max)
+        s.max = ticks;
+    if (s.histogram[bucket] < 0xFFFF)
+        s.histogram[bucket]++;
+    SREG = sreg;
+}
+
+/**
+ * @brief Print every probe's statistics, in cycles, and start over
+ *
+ * This is many lines, more than the log ring holds, so it waits for each
+ * line to go out.
+ */
+void profile_dump() {
+    PRINT("Profile (cycles), histogram buckets are 2^n * %d cycles\n", PROFILE_PRESCALE);
+    flush();
+    for (uint8_t i = 0; i < probe_count; ++i) {
+        profile_stats s;
+        cli();
+        s = stats[i];
+        profile_reset(stats[i]);
+        sei();
+
+        char name[16];
+        strcpy_P(name, probe_names[i]);
+        if (s.count == 0) {
+            PRINT("%s: none\n", name);
+            flush();
+            continue;
+        }
+
+        PRINT("%s: %lu, min: %lu, mean: %lu, max: %lu\n", name, s.count, s.min * (unsigned long)PROFILE_PRESCALE,
+              s.sum / s.count * PROFILE_PRESCALE, s.max * (unsigned long)PROFILE_PRESCALE);
+        flush();
+
+        PRINT(" ");
+        for (uint8_t b = 0; b < PROFILE_BUCKETS; ++b)
+            PRINT(" %u", s.histogram[b]);
+        PRINT("\n");
+        flush();
+    }
+}
+
+#endif
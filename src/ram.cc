@@ -0,0 +1,95 @@
+
+/**
+ * @brief RAM instrumentation
+ *
+ * The ATmega328P's 2K of RAM holds .data and .bss at the bottom, then the
+ * heap (malloc() is not used here, so it is empty), then the stack, which
+ * grows down from RAMEND. ram_paint() fills the space between the end of
+ * .bss and the stack pointer with RAM_CANARY. It runs from .init3: after
+ * the stack pointer and r1 are set up, before .data is copied and .bss is
+ * cleared, and before any constructor.
+ *
+ * The headroom is the number of canary bytes left above the heap. It can
+ * only shrink, so it is the worst case since boot.
+ */
+
+#include <Arduino.h>
+
+#include "print.h"
+#include "ram.h"
+
+#if RAM_CHECK
+
+#ifndef __AVR__
+#error "RAM_CHECK needs the AVR memory layout; use RAM_CHECK=0"
+#endif
+
+#define RAM_CANARY 0xC5
+#define RAM_WARN_BYTES 128        // Less headroom than this sets ram_low
+
+// From the linker script
+extern uint8_t __data_start;
+extern uint8_t __data_end;
+extern uint8_t __bss_start;
+extern uint8_t __bss_end;
+extern uint8_t __heap_start;
+extern char *__brkval;  // The top of the heap, 0 until malloc() is used
+
+volatile bool ram_low = false;
+
+void ram_paint() __attribute__((naked, used, section(".init3")));
+
+void ram_paint() {
+    uint8_t *p = &__heap_start;
+    uint8_t *sp = (uint8_t *)SP;
+    while (p < sp)
+        *p++ = RAM_CANARY;
+}
+
+static uint8_t *heap_end() {
+    return __brkval ? (uint8_t *)__brkval : &__heap_start;
+}
+
+/**
+ * @brief The bytes the stack has never reached, counted up from the heap
+ */
+static unsigned int ram_headroom() {
+    const uint8_t *p = heap_end();
+    const uint8_t *sp = (const uint8_t *)SP;
+    unsigned int n = 0;
+    while (p < sp && *p == RAM_CANARY) {
+        p++;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief The bytes between the heap and the stack pointer now
+ */
+static unsigned int ram_free() {
+    return (uint8_t *)SP - heap_end();
+}
+
+/**
+ * @brief Check the headroom; a task that runs every RAM_CHECK_INTERVAL ms
+ */
+void ram_poll() {
+    unsigned int headroom = ram_headroom();
+    if (headroom < RAM_WARN_BYTES && !ram_low) {
+        ram_low = true;
+        PRINT("Warning: RAM headroom is %u bytes\n", headroom);
+    }
+}
+
+void print_ram_stats() {
+    unsigned int data = &__data_end - &__data_start;
+    unsigned int bss = &__bss_end - &__bss_start;
+    unsigned int stack_max = (uint8_t *)RAMEND + 1 - heap_end() - ram_headroom();
+    PRINT("RAM: %d total, .data: %u, .bss: %u, heap: %u\n", RAMEND - RAMSTART + 1, data, bss,
+          (unsigned int)(heap_end() - &__heap_start));
+    PRINT("RAM: free: %u, stack max: %u, headroom: %u%s\n", ram_free(), stack_max, ram_headroom(),
+          ram_low ? " (low)" : "");
+}
+
+#endif
@@ -0,0 +1,62 @@
+
+/**
+ * @brief The reset cause, saved before the C runtime starts
+ *
+ * save_reset_flags() runs from .init3, like ram_paint(). It also turns
+ * the watchdog off: after a watchdog reset the watchdog stays on with
+ * its shortest timeout until WDRF is cleared.
+ */
+
+#include <Arduino.h>
+
+#include "reset.h"
+
+#define RESET_MAGIC 0x7E5E7C01UL
+
+#ifdef __AVR__
+
+#include <avr/wdt.h>
+
+static_assert(reset_power_on == _BV(PORF) && reset_external == _BV(EXTRF) && reset_brownout == _BV(BORF) &&
+                  reset_watchdog == _BV(WDRF),
+              "reset_cause must match MCUSR");
+
+static uint8_t saved_flags __attribute__((section(".noinit")));
+static uint32_t reset_magic __attribute__((section(".noinit")));
+static bool cold;
+
+void save_reset_flags() __attribute__((naked, used, section(".init3")));
+
+void save_reset_flags() {
+    saved_flags = MCUSR;
+    MCUSR = 0;
+    wdt_disable();
+}
+
+uint8_t reset_flags() {
+    return saved_flags;
+}
+
+/**
+ * @brief Was this a power-on? The first call decides; later calls return
+ * the same answer.
+ */
+bool reset_cold() {
+    if (reset_magic != RESET_MAGIC) {
+        reset_magic = RESET_MAGIC;
+        cold = true;
+    }
+    return cold || (saved_flags & reset_power_on);
+}
+
+#else
+
+uint8_t reset_flags() {
+    return reset_power_on;
+}
+
+bool reset_cold() {
+    return true;
+}
+
+#endif
@@ -0,0 +1,220 @@
+
+/**
+ * @brief The scheduler: a deadline heap and a mask of posted tasks
+ *
+ * The heap holds the tasks that have a deadline, earliest first, and is
+ * only changed from loop(). ISRs set a bit in 'posted' instead; sched_run()
+ * moves posted tasks to the head of the heap with a deadline of now. A
+ * task with a period is put back in the heap after it runs; a task
+ * without one waits until it is posted or given a deadline again.
+ *
+ * Deadlines are millis() values and are compared as differences, so the
+ * 49 day wrap does not matter. Each task runs at most once per pass, so a
+ * task that posts itself runs again on the next pass, after the sleep.
+ */
+
+#include <Arduino.h>
+
+#include "print.h"
+#include "scheduler.h"
+
+struct task {
+    task_function run;
+    unsigned int period_ms;  // 0 for a task that only runs when woken
+    unsigned long deadline;
+    unsigned long runs;
+    unsigned int worst_us;
+};
+
+static_assert(task_count <= 16, "posted has a bit per task");
+
+static task tasks[task_count];
+
+static uint8_t heap[task_count];
+static uint8_t heap_size = 0;
+static uint8_t heap_slot[task_count];  // 1 + where each task is in heap; 0 if it is not queued
+
+static volatile uint16_t posted = 0;  // A bit per task_id
+static volatile uint8_t running = task_count;  // The task in run(), task_count for none
+
+static const char task_names[task_count][SCHED_NAME_MAX] PROGMEM = {
+    "time", "switch", "serial", "log", "brightness", "ram", "settings",
+};
+
+static bool earlier(uint8_t a, uint8_t b) {
+    return (long)(tasks[heap[a]].deadline - tasks[heap[b]].deadline) < 0;
+}
+
+static void swap(uint8_t a, uint8_t b) {
+    uint8_t t = heap[a];
+    heap[a] = heap[b];
+    heap[b] = t;
+    heap_slot[heap[a]] = a + 1;
+    heap_slot[heap[b]] = b + 1;
+}
+
+static void sift_up(uint8_t i) {
+    while (i > 0) {
+        uint8_t parent = (i - 1) / 2;
+        if (!earlier(i, parent))
+            return;
+        swap(i, parent);
+        i = parent;
+    }
+}
+
+static void sift_down(uint8_t i) {
+    for (;;) {
+        uint8_t child = 2 * i + 1;
+        if (child >= heap_size)
+            return;
+        if (child + 1 < heap_size && earlier(child + 1, child))
+            child++;
+        if (!earlier(child, i))
+            return;
+        swap(i, child);
+        i = child;
+    }
+}
+
+/**
+ * @brief Queue a task for 'when', unless it is already queued for earlier
+ */
+static void enqueue(uint8_t id, unsigned long when) {
+    uint8_t i;
+    if (heap_slot[id] == 0) {
+        i = heap_size++;
+        heap[i] = id;
+        heap_slot[id] = i + 1;
+    } else if ((long)(when - tasks[id].deadline) >= 0) {
+        return;
+    } else {
+        i = heap_slot[id] - 1;
+    }
+    tasks[id].deadline = when;
+    sift_up(i);
+}
+
+static uint8_t dequeue() {
+    uint8_t id = heap[0];
+    heap_slot[id] = 0;
+    if (--heap_size > 0) {
+        heap[0] = heap[heap_size];
+        heap_slot[heap[0]] = 1;
+        sift_down(0);
+    }
+    return id;
+}
+
+/**
+ * @brief Add a task; with a period it first runs one period from now
+ */
+void sched_add(task_id id, task_function run, unsigned int period_ms) {
+    tasks[id].run = run;
+    tasks[id].period_ms = period_ms;
+    if (period_ms)
+        enqueue(id, millis() + period_ms);
+}
+
+/**
+ * @brief Run a task on the next pass of loop(); can be called from an ISR
+ */
+void sched_post(task_id id) {
+    uint8_t sreg = SREG;
+    cli();
+    posted |= 1 << id;
+    SREG = sreg;
+}
+
+/**
+ * @brief Run a task at 'when_ms' (a millis() value), or earlier if it is
+ * already due then; call from loop(), not from an ISR
+ */
+void sched_at(task_id id, unsigned long when_ms) {
+    enqueue(id, when_ms);
+}
+
+/**
+ * @brief Run the tasks that are due; call from loop()
+ */
+void sched_run() {
+    unsigned long now = millis();
+
+    cli();
+    uint16_t wakeups = posted;
+    posted = 0;
+    sei();
+
+    for (uint8_t id = 0; wakeups; ++id, wakeups >>= 1) {
+        if (wakeups & 1)
+            enqueue(id, now);
+    }
+
+    // At most one run per task per pass; a task can queue itself again
+    for (uint8_t n = task_count; n > 0 && heap_size > 0; --n) {
+        if ((long)(tasks[heap[0]].deadline - now) > 0)
+            break;
+
+        uint8_t id = dequeue();
+        task &t = tasks[id];
+
+        unsigned long start = micros();
+        running = id;
+        t.run();
+        running = task_count;
+        unsigned long elapsed = micros() - start;
+
+        t.runs++;
+        if (elapsed > t.worst_us)
+            t.worst_us = elapsed > 0xFFFF ? 0xFFFF : elapsed;
+
+        if (t.period_ms) {
+            unsigned long next = t.deadline + t.period_ms;
+            if ((long)(next - now) <= 0)
+                next = now + t.period_ms;  // Late; skip the missed runs
+            enqueue(id, next);
+        }
+    }
+}
+
+/**
+ * @brief Is a task due? For power_idle(), which calls this with interrupts
+ * off.
+ */
+bool sched_ready() {
+    if (posted)
+        return true;
+    return heap_size > 0 && (long)(tasks[heap[0]].deadline - millis()) <= 0;
+}
+
+/**
+ * @brief The task that is running, or task_count between tasks; for the
+ * watchdog's post-mortem record
+ */
+uint8_t sched_running() {
+    return running;
+}
+
+/**
+ * @brief The name of a task, or "none" for task_count
+ */
+void sched_task_name(uint8_t id, char *name) {
+    if (id < task_count)
+        strcpy_P(name, task_names[id]);
+    else
+        strcpy(name, "none");
+}
+
+/**
+ * @brief Print each task's run count and longest run, then reset them
+ */
+void print_sched_stats() {
+    char name[SCHED_NAME_MAX];
+    for (uint8_t id = 0; id < task_count; ++id) {
+        sched_task_name(id, name);
+        PRINT("Task %s: %lu runs, max: %uus\n", name, tasks[id].runs, tasks[id].worst_us);
+        flush();
+        tasks[id].runs = 0;
+        tasks[id].worst_us = 0;
+    }
+}
@@ -0,0 +1,193 @@
+
+/**
+ * @brief Serial commands for pulling statistics from a running clock
+ *
+ * Each command is one character; line endings are ignored. The commands
+ * that are built in depend on the build flags.
+ *
+ * The time sync commands (see tools/time_sync.py) are a letter and numbers
+ * and end at the newline:
+ *   T<token>            reply 'T <token> <seconds since 1970> <ms>'
+ *   S<seconds> <delay>  set the time in <delay> ms, reply 'S <seconds> <offset ms>'
+ *   C<pattern>          the colon's blink pattern (COLON_TIMER1), reply 'C <pattern>'
+ */
+
+#include <Arduino.h>
+
+#include "RTC.h"
+#include "brightness.h"
+#include "colon.h"
+#include "display.h"
+#include "hv_ps.h"
+#include "power.h"
+#include "print.h"
+#include "profile.h"
+#include "ram.h"
+#include "scheduler.h"
+#include "serial_cmd.h"
+#include "settings.h"
+#include "timebase.h"
+#include "watchdog.h"
+
+#if RTC_ASYNC
+#include "twi_async.h"
+#endif
+
+#define LINE_MAX 24
+
+static char line[LINE_MAX];
+static uint8_t line_length = 0;  // Not zero while reading a command's numbers
+
+static void run_line() {
+    line[line_length] = '\0';
+    char *end;
+    unsigned long a = strtoul(line + 1, &end, 10);
+    unsigned long b = strtoul(end, &end, 10);
+
+    switch (line[0]) {
+    case 'T':
+        time_sync_ping(a);
+        break;
+    case 'S':
+        time_sync_set(a, b);
+        break;
+#if COLON_TIMER1
+    case 'C':
+        if (a < colon_pattern_count) {
+            colon_set_pattern((colon_pattern)a);
+            settings s = settings_get();
+            s.colon = a;
+            settings_save(s);
+        }
+        PRINT("C %d\n", colon_get_pattern());
+        break;
+#endif
+    }
+}
+
+// This is more than the log ring holds, so it waits for the lines to go out
+static void print_help() {
+    PRINT("Commands: T<token> ping, S<time> <delay ms> set the time\n");
+    flush();
+#if COLON_TIMER1
+    PRINT("C<n> colon: 0 blink, 1 flash, 2 on, 3 off, 4 fade\n");
+    flush();
+#endif
+    PRINT("t time stats, b timebase stats, g brightness, l log stats, k tasks, e settings");
+    flush();
+#if RTC_ASYNC
+    PRINT(", i TWI stats");
+#endif
+#if DISPLAY_REFRESH_HZ
+    PRINT(", d display stats");
+#endif
+#if POWER_STATS
+    PRINT(", z power stats");
+#endif
+#if HV_PS
+    PRINT(", h HV supply");
+#endif
+#if PROFILE
+    PRINT(", p profile");
+#endif
+#if RAM_CHECK
+    PRINT(", m memory");
+#endif
+#if WATCHDOG
+    PRINT(", w resets");
+#endif
+    PRINT("\n");
+}
+
+/**
+ * @brief Run the commands that have come in; the serial task
+ *
+ * Each reply is sent before the next command runs, so a batch of
+ * commands cannot overflow the log ring.
+ */
+void serial_cmd_poll() {
+    while (Serial.available() > 0) {
+        char c = Serial.read();
+
+        if (line_length > 0) {
+            if (c == '\n' || c == '\r') {
+                run_line();
+                line_length = 0;
+            } else if (line_length < LINE_MAX - 1) {
+                line[line_length++] = c;
+            }
+            continue;
+        }
+
+        switch (c) {
+        case 'T':
+        case 'S':
+#if COLON_TIMER1
+        case 'C':
+#endif
+            line[0] = c;
+            line_length = 1;
+            break;
+        case 't':
+            print_time_stats();
+            break;
+        case 'b':
+            print_timebase_stats();
+            break;
+        case 'g':
+            print_brightness_stats();
+            break;
+        case 'l':
+            print_log_stats();
+            break;
+        case 'k':
+            print_sched_stats();
+            break;
+        case 'e':
+            print_settings_stats();
+            break;
+#if RTC_ASYNC
+        case 'i':
+            print_twi_stats();
+            break;
+#endif
+#if DISPLAY_REFRESH_HZ
+        case 'd':
+            print_display_stats();
+            break;
+#endif
+#if POWER_STATS
+        case 'z':
+            print_power_stats();
+            break;
+#endif
+#if HV_PS
+        case 'h':
+            print_hv_ps_stats();
+            break;
+#endif
+#if PROFILE
+        case 'p':
+            profile_dump();
+            break;
+#endif
+#if RAM_CHECK
+        case 'm':
+            print_ram_stats();
+            break;
+#endif
+#if WATCHDOG
+        case 'w':
+            print_watchdog_stats();
+            break;
+#endif
+        case '\r':
+        case '\n':
+            continue;
+        default:
+            print_help();
+            break;
+        }
+        flush();
+    }
+}
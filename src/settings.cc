@@ -0,0 +1,176 @@
+
+/**
+ * @brief The settings log in EEPROM
+ *
+ * A record is a sequence number, the settings and a CRC-8 of both. The
+ * newest record is the valid one with the highest sequence number; the
+ * numbers are compared as differences, so the 16 bit wrap does not
+ * matter. Erased EEPROM reads 0xFF, so sequence 0xFFFF is never used.
+ *
+ * A write takes 3.3ms a byte. The task writes a byte, which the EEPROM
+ * finishes on its own, and runs again after EEPROM_BYTE_MS, so loop()
+ * does not wait for it. eeprom_update_byte() skips the bytes that have
+ * not changed since the slot was last written.
+ */
+
+#include <Arduino.h>
+#include <stddef.h>
+
+#include "print.h"
+#include "scheduler.h"
+#include "settings.h"
+
+#define SEQUENCE_ERASED 0xFFFF
+#define EEPROM_BYTE_MS 4  // A byte write is 3.3ms
+
+static settings current = {0, 0, 0, 0, {0, 0, 0, 0}};  // Used until a record is found
+
+#if SETTINGS_EEPROM
+
+#ifndef __AVR__
+#error "The settings log needs the AVR EEPROM; use SETTINGS_EEPROM=0"
+#endif
+
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+struct settings_record {
+    uint16_t sequence;
+    settings s;
+    uint8_t crc;
+};
+
+static_assert(sizeof(settings_record) * SETTINGS_SLOTS <= E2END + 1, "The settings log is bigger than the EEPROM");
+
+static settings_record records[SETTINGS_SLOTS] EEMEM;
+
+static uint8_t newest_slot = SETTINGS_SLOTS - 1;  // The next write goes to the slot after
+static uint16_t newest_sequence = SEQUENCE_ERASED;
+
+// The record being written, a byte at a time
+static settings_record pending;
+static uint8_t pending_slot;
+static uint8_t pending_byte = 0;
+static bool writing = false;
+static bool dirty = false;
+
+static unsigned int writes = 0;
+static unsigned int bad_records = 0;  // Found at boot
+
+static uint8_t record_crc(const settings_record &r) {
+    const uint8_t *p = (const uint8_t *)&r;
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < offsetof(settings_record, crc); ++i)
+        crc = _crc8_ccitt_update(crc, p[i]);
+    return crc;
+}
+
+/**
+ * @brief Find the newest good record and load it; call once from setup()
+ */
+void settings_setup() {
+    bool found = false;
+    for (uint8_t slot = 0; slot < SETTINGS_SLOTS; ++slot) {
+        settings_record r;
+        eeprom_read_block(&r, &records[slot], sizeof(r));
+        if (r.sequence == SEQUENCE_ERASED)
+            continue;
+        if (r.crc != record_crc(r)) {
+            bad_records++;
+            continue;
+        }
+        if (!found || (int16_t)(r.sequence - newest_sequence) > 0) {
+            found = true;
+            newest_slot = slot;
+            newest_sequence = r.sequence;
+            current = r.s;
+        }
+    }
+}
+
+/**
+ * @brief Keep a change; the settings task writes it later
+ */
+void settings_save(const settings &s) {
+    if (memcmp(&s, &current, sizeof(s)) == 0)
+        return;
+    current = s;
+    dirty = true;
+    if (!writing)
+        sched_at(task_settings, millis() + SETTINGS_WRITE_DELAY_MS);
+}
+
+/**
+ * @brief Write the settings to the next slot; the settings task
+ */
+void settings_task() {
+    if (!writing) {
+        if (!dirty)
+            return;
+        dirty = false;
+        writing = true;
+        pending_byte = 0;
+        pending_slot = newest_slot + 1 == SETTINGS_SLOTS ? 0 : newest_slot + 1;
+        pending.sequence = newest_sequence + 1 == SEQUENCE_ERASED ? 0 : newest_sequence + 1;
+        pending.s = current;
+        pending.crc = record_crc(pending);
+    }
+
+    if (eeprom_is_ready()) {
+        eeprom_update_byte((uint8_t *)&records[pending_slot] + pending_byte, ((const uint8_t *)&pending)[pending_byte]);
+        if (++pending_byte == sizeof(pending)) {
+            writing = false;
+            newest_slot = pending_slot;
+            newest_sequence = pending.sequence;
+            writes++;
+            if (dirty)
+                sched_at(task_settings, millis() + SETTINGS_WRITE_DELAY_MS);
+            return;
+        }
+    }
+
+    sched_at(task_settings, millis() + EEPROM_BYTE_MS);
+}
+
+/**
+ * @brief Keep a change and write it now, waiting on the EEPROM; for a
+ * change that another reset soon after would lose
+ */
+void settings_save_now(const settings &s) {
+    settings_save(s);
+    while (writing || dirty) {
+        eeprom_busy_wait();
+        settings_task();
+    }
+}
+
+#else
+
+void settings_setup() {
+}
+
+void settings_save(const settings &s) {
+    current = s;
+}
+
+void settings_save_now(const settings &s) {
+    current = s;
+}
+
+void settings_task() {
+}
+
+#endif  // SETTINGS_EEPROM
+
+const settings &settings_get() {
+    return current;
+}
+
+void print_settings_stats() {
+#if SETTINGS_EEPROM
+    PRINT("Settings: slot %u, sequence %u, %u writes, %u bad records\n", newest_slot, newest_sequence, writes,
+          bad_records);
+#endif
+    PRINT("Brightness %u, colon %u, last sync %lu, off by %ld ms\n", current.brightness, current.colon,
+          current.sync_time, current.sync_offset_ms);
+}
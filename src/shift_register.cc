@@ -0,0 +1,139 @@
+
+/**
+ * @brief Drive the 74HC595 shift register chain
+ *
+ * The bytes for the whole chain are sent and then REGISTER_CLK (the
+ * latch) is pulsed once, so the tubes change all at once.
+ *
+ * With SHIFT_OUT_SPI the bytes go out of the hardware SPI port at
+ * F_CPU/2. The first byte is written to SPDR by updateShiftRegister() and
+ * the 'transfer complete' ISR writes the rest and then latches, so the
+ * caller does not wait and interrupts are never turned off for the
+ * transfer. Two bytes take a few microseconds, mostly ISR overhead, versus
+ * roughly 200us for a bit-bang with shiftOut(). The bit-bang here uses
+ * fast_pin, so it is much quicker than that, but the caller still waits.
+ */
+
+#include <Arduino.h>
+
+#include "fast_pin.h"
+#include "pins.h"
+#include "profile.h"
+#include "shift_register.h"
+
+#if !defined(__AVR__) && SHIFT_REGISTER_TRANSPORT != SHIFT_OUT_BITBANG
+#error "Only the bit-bang shift register transport is available off the AVR"
+#endif
+
+#if SHIFT_REGISTER_TRANSPORT == SHIFT_OUT_SPI
+
+static uint8_t tx_buffer[SHIFT_REGISTER_MAX_BYTES];
+static volatile uint8_t tx_next = 0;
+static volatile uint8_t tx_count = 0;
+static volatile bool tx_busy = false;
+
+void shift_register_setup() {
+    fast_pin<REGISTER_CLK>::output();
+    fast_pin<SERIAL_CLK>::output();
+    fast_pin<SERIAL_DATA>::output();
+    fast_pin<SS>::output();  // An input SS pin can drop the SPI port out of master mode
+
+    // SPI master, MSB first, mode 0 (the 595 clocks on the rising edge),
+    // F_CPU/2, interrupt on transfer complete.
+    SPCR = _BV(SPE) | _BV(MSTR) | _BV(SPIE);
+    SPSR = _BV(SPI2X);
+}
+
+bool shift_register_busy() {
+    return tx_busy;
+}
+
+/**
+ * Send the next byte or, when the chain has been sent, latch the data.
+ */
+ISR(SPI_STC_vect) {
+    if (tx_next < tx_count) {
+        SPDR = tx_buffer[tx_next++];
+    } else {
+        fast_pin<REGISTER_CLK>::high();
+        tx_busy = false;
+    }
+}
+
+/**
+ * @brief Start sending n bytes to the shift register chain
+ *
+ * data[0] is sent first, so it ends up in the register farthest from the
+ * MCU. If a transfer is already under way, wait for it; that's at most a
+ * few microseconds. Returns before the transfer is done.
+ */
+void updateShiftRegister(const uint8_t *data, uint8_t n) {
+    PROFILE_SCOPE(probe_shift_register);
+
+    if (n == 0)
+        return;
+    if (n > SHIFT_REGISTER_MAX_BYTES)
+        n = SHIFT_REGISTER_MAX_BYTES;
+
+    while (tx_busy)
+        ;
+
+    for (uint8_t i = 0; i < n; ++i)
+        tx_buffer[i] = data[i];
+    tx_count = n;
+    tx_next = 1;
+    tx_busy = true;
+
+    fast_pin<REGISTER_CLK>::low();
+    SPDR = tx_buffer[0];
+}
+
+#else  // SHIFT_OUT_BITBANG
+
+void shift_register_setup() {
+    fast_pin<REGISTER_CLK>::output();
+    fast_pin<SERIAL_CLK>::output();
+    fast_pin<SERIAL_DATA>::output();
+}
+
+bool shift_register_busy() {
+    return false;
+}
+
+// shiftOut()'s pin sequence, MSB first, without its digitalWrite() calls
+static void shift_out(uint8_t value) {
+    for (uint8_t bit = 0x80; bit; bit >>= 1) {
+        fast_pin<SERIAL_DATA>::write(value & bit);
+        fast_pin<SERIAL_CLK>::high();
+        fast_pin<SERIAL_CLK>::low();
+    }
+}
+
+/*
+ * updateShiftRegister() - This function sets the REGISTER_CLK pin to low,
+ * then calls shift_out() to shift out contents of 'data' in the shift
+ * register before putting 'REGISTER_CLK' high again.
+ *
+ * On a scope, it appears that the SERIAL_DATA pin is left high or low depending
+ * on the last bit value written. I set it LOW so that every call has the
+ * same initial condition, although I'm not sure that difference matters to
+ * the 595 chips.
+ *
+ * I switched to this code over the ShiftRegister74HC595 library because I was
+ * getting an odd error where sometimes the values ouput were corrupted. The
+ * problem might have been noise on the breadboard or it might have been an
+ * issue with interrupts. NB: It was noise; the HV PS that used the PID controller
+ * was noisy and that was fixed by using a better HV PS. That also meant tha
+ * the PID controller could be dumped.
+ */
+void updateShiftRegister(const uint8_t *data, uint8_t n) {
+    PROFILE_SCOPE(probe_shift_register);
+
+    fast_pin<REGISTER_CLK>::low();
+    for (uint8_t i = 0; i < n; ++i)
+        shift_out(data[i]);
+    fast_pin<REGISTER_CLK>::high();
+    fast_pin<SERIAL_DATA>::low();
+}
+
+#endif
@@ -0,0 +1,32 @@
+
+/**
+ * @brief The Timer0 compare A ISR
+ *
+ * OCR0A is not used for PWM (pin 6, OC0A, is free), so setting it does
+ * not change Timer0's period or the HV_PWM_CONTROL output on OC0B. The
+ * match is set half way through the period, away from the overflow ISR.
+ */
+
+#include <Arduino.h>
+
+#include "brightness.h"
+#include "hv_ps.h"
+#include "mode_switch.h"
+#include "tick.h"
+
+#ifdef __AVR__
+ISR(TIMER0_COMPA_vect) {
+    input_switch_sample();
+    brightness_tick();
+#if HV_PS
+    hv_ps_tick();
+#endif
+}
+#endif
+
+void tick_setup() {
+#ifdef __AVR__
+    OCR0A = 0x80;
+    TIMSK0 |= _BV(OCIE0A);
+#endif
+}
@@ -0,0 +1,160 @@
+
+/**
+ * @brief The RTC-disciplined timebase
+ *
+ * timebase_edge() runs in the SQW ISR on each falling edge. The micros()
+ * between two edges is the RTC second measured by the MCU; 1000000 plus
+ * the resonator's error in ppm. A second that is off by more than
+ * MAX_ERROR_PPM is a missed or extra edge and is not used, but the
+ * seconds a long gap spans are still counted.
+ *
+ * The second length is filtered with an exponential average (1/8 of each
+ * new value) kept with 4 fraction bits. The error, min and max since the
+ * last report are a measure of the resonator's health: a board whose
+ * error is large or jumps around has a bad part or a hot spot.
+ */
+
+#include <Arduino.h>
+
+#include "print.h"
+#include "timebase.h"
+
+#define NOMINAL_SECOND 1000000L  // us
+#define MAX_ERROR_PPM 20000L     // 2%, well beyond any working resonator
+#define FILTER_SHIFT 3           // each new second is weighted 1/8
+
+static volatile unsigned long last_edge_us = 0;
+static volatile uint32_t seconds = 0;          // RTC seconds since boot
+static volatile long period_q4 = NOMINAL_SECOND << 4;  // us, 4 fraction bits
+static bool have_edge = false;
+static volatile uint32_t last_now_ms = 0;  // The last now_ms() value
+
+// Since the last report
+static volatile unsigned int edges = 0;
+static volatile unsigned int rejected = 0;
+static volatile long error_min = MAX_ERROR_PPM;
+static volatile long error_max = -MAX_ERROR_PPM;
+
+/**
+ * @brief Measure the RTC second that just ended; call from the SQW ISR on
+ * the falling edge
+ */
+void timebase_edge() {
+    unsigned long now = micros();
+    long error = (long)(now - last_edge_us) - NOMINAL_SECOND;
+    last_edge_us = now;
+    seconds++;
+
+    if (!have_edge) {
+        have_edge = true;
+        return;
+    }
+
+    if (error > MAX_ERROR_PPM || error < -MAX_ERROR_PPM) {
+        // Count the seconds whose edges were missed
+        for (; error > NOMINAL_SECOND / 2; error -= NOMINAL_SECOND)
+            seconds++;
+        rejected++;
+        return;
+    }
+
+    edges++;
+    if (error < error_min)
+        error_min = error;
+    if (error > error_max)
+        error_max = error;
+
+    long period = (NOMINAL_SECOND + error) << 4;
+    period_q4 += (period - period_q4) >> FILTER_SHIFT;
+}
+
+/**
+ * @brief Start the second over now, for when the RTC has been set and
+ * the SQW phase changed
+ */
+void timebase_restart() {
+    cli();
+    last_edge_us = micros();
+    have_edge = false;
+    sei();
+}
+
+/**
+ * @brief Milliseconds since boot in RTC time
+ *
+ * The RTC seconds counted from the SQW edges, plus the time since the
+ * last edge scaled by the measured length of a second. Until the next
+ * edge comes, the value stops at the end of the second. If the edges
+ * stop, it runs on using the last measured rate; when they come back
+ * (or after a missed edge) that can be ahead of the count of edges, so
+ * the value holds at the last one returned until the edges catch up. It
+ * never goes back.
+ *
+ * This can be called from an ISR.
+ */
+uint32_t now_ms() {
+    uint8_t sreg = SREG;
+    cli();
+    unsigned long edge = last_edge_us;
+    uint32_t secs = seconds;
+    unsigned long period = period_q4 >> 4;
+    SREG = sreg;
+
+    unsigned long elapsed = micros() - edge;
+    // In 16us units so the product fits in 32 bits for up to a minute
+    unsigned long ms = (elapsed >> 4) * 1000 / (period >> 4);
+    if (ms > 999 && elapsed < period + period / 2)
+        ms = 999;
+    uint32_t now = secs * 1000 + ms;
+
+    sreg = SREG;
+    cli();
+    if ((int32_t)(now - last_now_ms) < 0)
+        now = last_now_ms;
+    else
+        last_now_ms = now;
+    SREG = sreg;
+
+    return now;
+}
+
+/**
+ * @brief The SQW seconds (falling edges) counted since boot; can be
+ * called from an ISR
+ */
+uint32_t timebase_seconds() {
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t secs = seconds;
+    SREG = sreg;
+    return secs;
+}
+
+/**
+ * @brief The filtered error of the MCU's clock against the RTC, in ppm;
+ * positive when the MCU runs fast
+ */
+long timebase_ppm() {
+    cli();
+    long period = period_q4;
+    sei();
+    return (period - (NOMINAL_SECOND << 4)) >> 4;
+}
+
+void print_timebase_stats() {
+    cli();
+    unsigned int n = edges;
+    unsigned int bad = rejected;
+    long lo = error_min;
+    long hi = error_max;
+    edges = 0;
+    rejected = 0;
+    error_min = MAX_ERROR_PPM;
+    error_max = -MAX_ERROR_PPM;
+    sei();
+
+    PRINT("Timebase: %ld ppm, seconds: %u, rejected: %u", timebase_ppm(), n, bad);
+    if (n)
+        PRINT(", min: %ld, max: %ld", lo, hi);
+    PRINT("\n");
+}
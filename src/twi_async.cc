@@ -0,0 +1,306 @@
+
+/**
+ * @brief A non-blocking TWI (I2C) master for the RTC
+ *
+ * A transfer is a register address write followed by either more bytes
+ * (a register write) or a repeated start and a burst read. The state
+ * machine in twi_step() handles one TWINT event at a time.
+ *
+ * By default twi_step() is run from twi_poll(). RTClib's DateTime code
+ * shares an object file with its I2C code, which pulls in the Wire library
+ * and its TWI ISR, so a second ISR(TWI_vect) will not link. Builds that do
+ * not link Wire can set TWI_INTERRUPT=1 to run the state machine from the
+ * TWI interrupt instead. Either way nothing waits on the bus.
+ *
+ * @see ATmega328P datasheet, section 22 (2-wire Serial Interface)
+ */
+
+#include <Arduino.h>
+
+#include "fast_pin.h"
+#include "print.h"
+#include "twi_async.h"
+
+#ifdef __AVR__
+
+#ifndef TWI_INTERRUPT
+#define TWI_INTERRUPT 0
+#endif
+
+#define TWI_FREQ 100000L
+
+// Status codes (TWSR & 0xF8), master transmitter and receiver modes
+#define TW_START 0x08
+#define TW_REP_START 0x10
+#define TW_MT_SLA_ACK 0x18
+#define TW_MT_SLA_NACK 0x20
+#define TW_MT_DATA_ACK 0x28
+#define TW_MT_DATA_NACK 0x30
+#define TW_ARB_LOST 0x38
+#define TW_MR_SLA_ACK 0x40
+#define TW_MR_SLA_NACK 0x48
+#define TW_MR_DATA_ACK 0x50
+#define TW_MR_DATA_NACK 0x58
+
+#if TWI_INTERRUPT
+#define TWI_CONTROL (_BV(TWINT) | _BV(TWEN) | _BV(TWIE))
+#else
+#define TWI_CONTROL (_BV(TWINT) | _BV(TWEN))
+#endif
+
+static volatile twi_status status = twi_idle;
+static twi_callback callback = 0;
+
+static uint8_t slave_addr;
+static uint8_t reg_addr;
+static bool reading;
+static uint8_t *rx_buf;
+static uint8_t tx_buf[TWI_MAX_TRANSFER];
+static uint8_t length;
+static volatile uint8_t pos;
+static bool stopping;  // The START waits for the last STOP to go out
+
+static unsigned long start_ms;
+
+// Counters since boot
+static unsigned int twi_transfers = 0;
+static unsigned int twi_failures = 0;
+static unsigned int twi_timeouts = 0;
+static unsigned int twi_recoveries = 0;
+
+void twi_setup() {
+    // Internal pull ups, as Wire does; the RTC breakouts have their own
+    fast_pin<SDA>::high();
+    fast_pin<SCL>::high();
+
+    TWSR = 0;  // prescaler 1
+    TWBR = ((F_CPU / TWI_FREQ) - 16) / 2;
+    TWCR = _BV(TWEN);
+}
+
+static void stop(twi_status result) {
+    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+    status = result;
+}
+
+/**
+ * @brief Advance the transfer on a TWINT event
+ */
+static void twi_step() {
+    switch (TWSR & 0xF8) {
+    case TW_START:
+        TWDR = slave_addr << 1;  // SLA+W, to send the register address
+        TWCR = TWI_CONTROL;
+        break;
+
+    case TW_REP_START:
+        TWDR = (slave_addr << 1) | 1;  // SLA+R
+        TWCR = TWI_CONTROL;
+        break;
+
+    case TW_MT_SLA_ACK:
+        TWDR = reg_addr;
+        TWCR = TWI_CONTROL;
+        break;
+
+    case TW_MT_DATA_ACK:
+        if (reading) {
+            TWCR = TWI_CONTROL | _BV(TWSTA);  // repeated start, then read
+        } else if (pos < length) {
+            TWDR = tx_buf[pos++];
+            TWCR = TWI_CONTROL;
+        } else {
+            stop(twi_done);
+        }
+        break;
+
+    case TW_MR_SLA_ACK:
+        // ACK every byte but the last
+        TWCR = (length > 1) ? (TWI_CONTROL | _BV(TWEA)) : TWI_CONTROL;
+        break;
+
+    case TW_MR_DATA_ACK:
+        rx_buf[pos++] = TWDR;
+        TWCR = (pos < length - 1) ? (TWI_CONTROL | _BV(TWEA)) : TWI_CONTROL;
+        break;
+
+    case TW_MR_DATA_NACK:
+        rx_buf[pos++] = TWDR;
+        stop(twi_done);
+        break;
+
+    case TW_MT_SLA_NACK:
+    case TW_MT_DATA_NACK:
+    case TW_MR_SLA_NACK:
+        stop(twi_nack);
+        break;
+
+    case TW_ARB_LOST:
+        TWCR = _BV(TWEN);  // release the bus
+        status = twi_error;
+        break;
+
+    default:  // 0x00 is a bus error
+        stop(twi_error);
+        break;
+    }
+}
+
+#if TWI_INTERRUPT
+ISR(TWI_vect) {
+    twi_step();
+}
+#endif
+
+static bool start(uint8_t addr, uint8_t reg, uint8_t n, bool read, twi_callback done) {
+    if (status == twi_busy || n == 0 || n > TWI_MAX_TRANSFER)
+        return false;
+
+    slave_addr = addr;
+    reg_addr = reg;
+    length = n;
+    reading = read;
+    pos = 0;
+    callback = done;
+    start_ms = millis();
+    twi_transfers++;
+
+    status = twi_busy;
+    // A START written while the last STOP is still going out is lost, so
+    // twi_poll() sends it once TWSTO clears
+    stopping = TWCR & _BV(TWSTO);
+    if (!stopping)
+        TWCR = TWI_CONTROL | _BV(TWSTA);
+
+    return true;
+}
+
+/**
+ * @brief Start reading n registers from addr, beginning with reg
+ * @return false if a transfer is already under way or n is too big
+ */
+bool twi_start_read(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t n, twi_callback done) {
+    rx_buf = buf;
+    return start(addr, reg, n, true, done);
+}
+
+/**
+ * @brief Start writing n registers to addr, beginning with reg
+ *
+ * The data are copied, so buf can be reused as soon as this returns.
+ */
+bool twi_start_write(uint8_t addr, uint8_t reg, const uint8_t *buf, uint8_t n, twi_callback done) {
+    if (status == twi_busy || n > TWI_MAX_TRANSFER)
+        return false;
+    memcpy(tx_buf, buf, n);
+    return start(addr, reg, n, false, done);
+}
+
+bool twi_in_progress() {
+    return status == twi_busy;
+}
+
+/**
+ * @brief Clear a slave that is holding SDA low
+ *
+ * This happens when the MCU resets in the middle of a read: the slave is
+ * waiting to clock out the rest of a byte. Clock SCL (up to nine times)
+ * until SDA is released, then send a STOP and restart the TWI.
+ *
+ * @return true if SDA was released
+ */
+bool twi_bus_recover() {
+    TWCR = 0;  // Give the pins back to the port
+    twi_recoveries++;
+
+    fast_pin<SDA>::input_pullup();
+    fast_pin<SCL>::input_pullup();
+    delayMicroseconds(5);
+
+    for (uint8_t i = 0; i < 9 && !fast_pin<SDA>::read(); ++i) {
+        // Pull SCL low by switching it to an output; let the pull up raise it
+        fast_pin<SCL>::low();
+        fast_pin<SCL>::output();
+        delayMicroseconds(5);
+        fast_pin<SCL>::input_pullup();
+        delayMicroseconds(5);
+    }
+
+    // STOP: SDA goes high while SCL is high
+    fast_pin<SDA>::low();
+    fast_pin<SDA>::output();
+    delayMicroseconds(5);
+    fast_pin<SDA>::input_pullup();
+    delayMicroseconds(5);
+
+    bool released = fast_pin<SDA>::read();
+
+    twi_setup();
+    stopping = false;
+    status = twi_idle;
+
+    return released;
+}
+
+/**
+ * @brief Move the transfer along and check for the end of it
+ *
+ * Call this from loop(). When a transfer ends, the completion function
+ * (if any) is called here, not in an ISR, and the result is returned;
+ * the state is then idle again. A slave holding SCL low, during a
+ * transfer or the STOP before it, times out the same way.
+ */
+twi_status twi_poll() {
+    if (stopping && !(TWCR & _BV(TWSTO))) {
+        stopping = false;
+        TWCR = TWI_CONTROL | _BV(TWSTA);
+    }
+
+#if !TWI_INTERRUPT
+    while (status == twi_busy && !stopping && (TWCR & _BV(TWINT)))
+        twi_step();
+#endif
+
+    twi_status result = status;
+
+    if (result == twi_busy) {
+        if (millis() - start_ms <= TWI_TIMEOUT_MS)
+            return twi_busy;
+
+        twi_timeouts++;
+        DPRINTV("TWI timeout, register 0x%02x, %d bytes done\n", reg_addr, pos);
+        twi_bus_recover();
+        result = twi_timeout;
+    }
+
+    if (result == twi_idle)
+        return twi_idle;
+
+    if (result != twi_done)
+        twi_failures++;
+
+    status = twi_idle;
+    twi_callback done = callback;
+    callback = 0;
+    if (done)
+        done(result);
+
+    return result;
+}
+
+/**
+ * @brief Wait for the current transfer to end, for use in setup()
+ */
+twi_status twi_wait() {
+    twi_status result;
+    while ((result = twi_poll()) == twi_busy)
+        ;
+    return result;
+}
+
+void print_twi_stats() {
+    PRINT("TWI transfers: %u, failures: %u, timeouts: %u, bus recoveries: %u\n", twi_transfers, twi_failures,
+          twi_timeouts, twi_recoveries);
+}
+
+#endif  // __AVR__
@@ -0,0 +1,75 @@
+
+/**
+ * @brief The UTC offset lookup
+ *
+ * The entry in effect is cached with the time it ends. A time inside it
+ * is answered without reading the table; the next time after it is
+ * usually in the next entry, so that is checked before a binary search.
+ */
+
+#include <Arduino.h>
+
+#include "print.h"
+#include "tz.h"
+
+#if RTC_UTC
+
+// The entry in effect; empty (and not followed by anything) until the first lookup
+static uint16_t cached = 0;
+static uint32_t cached_start = 0xFFFFFFFF;
+static uint32_t cached_end = 0xFFFFFFFF;  // The next entry's time, or 0xFFFFFFFF
+static int16_t cached_offset = 0;
+
+static unsigned int lookups = 0;
+static unsigned int searches = 0;
+
+static uint32_t entry_time(uint16_t i) {
+    return i < tz_transition_count ? pgm_read_dword(&tz_transitions[i].utc) : 0xFFFFFFFF;
+}
+
+static void load(uint16_t i) {
+    cached = i;
+    cached_start = entry_time(i);
+    cached_end = entry_time(i + 1);
+    cached_offset = (int16_t)pgm_read_word(&tz_transitions[i].offset_min);
+}
+
+/**
+ * @brief The UTC offset, in minutes, at 'utc'
+ * @param until Set to the time the offset next changes (0xFFFFFFFF for
+ * never, as far as the table goes)
+ */
+int16_t tz_offset(uint32_t utc, uint32_t &until) {
+    lookups++;
+    if (utc < cached_start || utc >= cached_end) {
+        if (utc >= cached_end && utc < entry_time(cached + 2)) {
+            load(cached + 1);
+        } else {
+            // The last entry at or before utc; entry 0 is at 0
+            searches++;
+            uint16_t lo = 0, hi = tz_transition_count;
+            while (hi - lo > 1) {
+                uint16_t mid = (lo + hi) / 2;
+                if (entry_time(mid) <= utc)
+                    lo = mid;
+                else
+                    hi = mid;
+            }
+            load(lo);
+        }
+    }
+    until = cached_end;
+    return cached_offset;
+}
+
+void print_tz_stats() {
+    const __FlashStringHelper *name = (const __FlashStringHelper *)tz_name;
+    int16_t offset = cached_offset;
+    char sign = offset < 0 ? '-' : '+';
+    if (offset < 0)
+        offset = -offset;
+    PRINT("Zone %S: UTC%c%d:%02d until %lu, %u lookups, %u searches\n", name, sign, offset / 60, offset % 60,
+          cached_end, lookups, searches);
+}
+
+#endif  // RTC_UTC
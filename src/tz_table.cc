@@ -0,0 +1,175 @@
+
+/**
+ * @brief The time zone table for America/New_York, 2024 - 2099
+ *
+ * Made by tools/tz_table.py; to change the zone or the years, run
+ *   tools/tz_table.py America/New_York > src/tz_table.cc
+ */
+
+#include <Arduino.h>
+
+#include "tz.h"
+
+#if RTC_UTC
+
+const char tz_name[] PROGMEM = "America/New_York";
+
+const tz_transition tz_transitions[] PROGMEM = {
+    {0UL, -300},           // 1970-01-01 00:00 UTC: UTC-5:00 EST
+    {1710054000UL, -240},  // 2024-03-10 07:00 UTC: UTC-4:00 EDT
+    {1730613600UL, -300},  // 2024-11-03 06:00 UTC: UTC-5:00 EST
+    {1741503600UL, -240},  // 2025-03-09 07:00 UTC: UTC-4:00 EDT
+    {1762063200UL, -300},  // 2025-11-02 06:00 UTC: UTC-5:00 EST
+    {1772953200UL, -240},  // 2026-03-08 07:00 UTC: UTC-4:00 EDT
+    {1793512800UL, -300},  // 2026-11-01 06:00 UTC: UTC-5:00 EST
+    {1805007600UL, -240},  // 2027-03-14 07:00 UTC: UTC-4:00 EDT
+    {1825567200UL, -300},  // 2027-11-07 06:00 UTC: UTC-5:00 EST
+    {1836457200UL, -240},  // 2028-03-12 07:00 UTC: UTC-4:00 EDT
+    {1857016800UL, -300},  // 2028-11-05 06:00 UTC: UTC-5:00 EST
+    {1867906800UL, -240},  // 2029-03-11 07:00 UTC: UTC-4:00 EDT
+    {1888466400UL, -300},  // 2029-11-04 06:00 UTC: UTC-5:00 EST
+    {1899356400UL, -240},  // 2030-03-10 07:00 UTC: UTC-4:00 EDT
+    {1919916000UL, -300},  // 2030-11-03 06:00 UTC: UTC-5:00 EST
+    {1930806000UL, -240},  // 2031-03-09 07:00 UTC: UTC-4:00 EDT
+    {1951365600UL, -300},  // 2031-11-02 06:00 UTC: UTC-5:00 EST
+    {1962860400UL, -240},  // 2032-03-14 07:00 UTC: UTC-4:00 EDT
+    {1983420000UL, -300},  // 2032-11-07 06:00 UTC: UTC-5:00 EST
+    {1994310000UL, -240},  // 2033-03-13 07:00 UTC: UTC-4:00 EDT
+    {2014869600UL, -300},  // 2033-11-06 06:00 UTC: UTC-5:00 EST
+    {2025759600UL, -240},  // 2034-03-12 07:00 UTC: UTC-4:00 EDT
+    {2046319200UL, -300},  // 2034-11-05 06:00 UTC: UTC-5:00 EST
+    {2057209200UL, -240},  // 2035-03-11 07:00 UTC: UTC-4:00 EDT
+    {2077768800UL, -300},  // 2035-11-04 06:00 UTC: UTC-5:00 EST
+    {2088658800UL, -240},  // 2036-03-09 07:00 UTC: UTC-4:00 EDT
+    {2109218400UL, -300},  // 2036-11-02 06:00 UTC: UTC-5:00 EST
+    {2120108400UL, -240},  // 2037-03-08 07:00 UTC: UTC-4:00 EDT
+    {2140668000UL, -300},  // 2037-11-01 06:00 UTC: UTC-5:00 EST
+    {2152162800UL, -240},  // 2038-03-14 07:00 UTC: UTC-4:00 EDT
+    {2172722400UL, -300},  // 2038-11-07 06:00 UTC: UTC-5:00 EST
+    {2183612400UL, -240},  // 2039-03-13 07:00 UTC: UTC-4:00 EDT
+    {2204172000UL, -300},  // 2039-11-06 06:00 UTC: UTC-5:00 EST
+    {2215062000UL, -240},  // 2040-03-11 07:00 UTC: UTC-4:00 EDT
+    {2235621600UL, -300},  // 2040-11-04 06:00 UTC: UTC-5:00 EST
+    {2246511600UL, -240},  // 2041-03-10 07:00 UTC: UTC-4:00 EDT
+    {2267071200UL, -300},  // 2041-11-03 06:00 UTC: UTC-5:00 EST
+    {2277961200UL, -240},  // 2042-03-09 07:00 UTC: UTC-4:00 EDT
+    {2298520800UL, -300},  // 2042-11-02 06:00 UTC: UTC-5:00 EST
+    {2309410800UL, -240},  // 2043-03-08 07:00 UTC: UTC-4:00 EDT
+    {2329970400UL, -300},  // 2043-11-01 06:00 UTC: UTC-5:00 EST
+    {2341465200UL, -240},  // 2044-03-13 07:00 UTC: UTC-4:00 EDT
+    {2362024800UL, -300},  // 2044-11-06 06:00 UTC: UTC-5:00 EST
+    {2372914800UL, -240},  // 2045-03-12 07:00 UTC: UTC-4:00 EDT
+    {2393474400UL, -300},  // 2045-11-05 06:00 UTC: UTC-5:00 EST
+    {2404364400UL, -240},  // 2046-03-11 07:00 UTC: UTC-4:00 EDT
+    {2424924000UL, -300},  // 2046-11-04 06:00 UTC: UTC-5:00 EST
+    {2435814000UL, -240},  // 2047-03-10 07:00 UTC: UTC-4:00 EDT
+    {2456373600UL, -300},  // 2047-11-03 06:00 UTC: UTC-5:00 EST
+    {2467263600UL, -240},  // 2048-03-08 07:00 UTC: UTC-4:00 EDT
+    {2487823200UL, -300},  // 2048-11-01 06:00 UTC: UTC-5:00 EST
+    {2499318000UL, -240},  // 2049-03-14 07:00 UTC: UTC-4:00 EDT
+    {2519877600UL, -300},  // 2049-11-07 06:00 UTC: UTC-5:00 EST
+    {2530767600UL, -240},  // 2050-03-13 07:00 UTC: UTC-4:00 EDT
+    {2551327200UL, -300},  // 2050-11-06 06:00 UTC: UTC-5:00 EST
+    {2562217200UL, -240},  // 2051-03-12 07:00 UTC: UTC-4:00 EDT
+    {2582776800UL, -300},  // 2051-11-05 06:00 UTC: UTC-5:00 EST
+    {2593666800UL, -240},  // 2052-03-10 07:00 UTC: UTC-4:00 EDT
+    {2614226400UL, -300},  // 2052-11-03 06:00 UTC: UTC-5:00 EST
+    {2625116400UL, -240},  // 2053-03-09 07:00 UTC: UTC-4:00 EDT
+    {2645676000UL, -300},  // 2053-11-02 06:00 UTC: UTC-5:00 EST
+    {2656566000UL, -240},  // 2054-03-08 07:00 UTC: UTC-4:00 EDT
+    {2677125600UL, -300},  // 2054-11-01 06:00 UTC: UTC-5:00 EST
+    {2688620400UL, -240},  // 2055-03-14 07:00 UTC: UTC-4:00 EDT
+    {2709180000UL, -300},  // 2055-11-07 06:00 UTC: UTC-5:00 EST
+    {2720070000UL, -240},  // 2056-03-12 07:00 UTC: UTC-4:00 EDT
+    {2740629600UL, -300},  // 2056-11-05 06:00 UTC: UTC-5:00 EST
+    {2751519600UL, -240},  // 2057-03-11 07:00 UTC: UTC-4:00 EDT
+    {2772079200UL, -300},  // 2057-11-04 06:00 UTC: UTC-5:00 EST
+    {2782969200UL, -240},  // 2058-03-10 07:00 UTC: UTC-4:00 EDT
+    {2803528800UL, -300},  // 2058-11-03 06:00 UTC: UTC-5:00 EST
+    {2814418800UL, -240},  // 2059-03-09 07:00 UTC: UTC-4:00 EDT
+    {2834978400UL, -300},  // 2059-11-02 06:00 UTC: UTC-5:00 EST
+    {2846473200UL, -240},  // 2060-03-14 07:00 UTC: UTC-4:00 EDT
+    {2867032800UL, -300},  // 2060-11-07 06:00 UTC: UTC-5:00 EST
+    {2877922800UL, -240},  // 2061-03-13 07:00 UTC: UTC-4:00 EDT
+    {2898482400UL, -300},  // 2061-11-06 06:00 UTC: UTC-5:00 EST
+    {2909372400UL, -240},  // 2062-03-12 07:00 UTC: UTC-4:00 EDT
+    {2929932000UL, -300},  // 2062-11-05 06:00 UTC: UTC-5:00 EST
+    {2940822000UL, -240},  // 2063-03-11 07:00 UTC: UTC-4:00 EDT
+    {2961381600UL, -300},  // 2063-11-04 06:00 UTC: UTC-5:00 EST
+    {2972271600UL, -240},  // 2064-03-09 07:00 UTC: UTC-4:00 EDT
+    {2992831200UL, -300},  // 2064-11-02 06:00 UTC: UTC-5:00 EST
+    {3003721200UL, -240},  // 2065-03-08 07:00 UTC: UTC-4:00 EDT
+    {3024280800UL, -300},  // 2065-11-01 06:00 UTC: UTC-5:00 EST
+    {3035775600UL, -240},  // 2066-03-14 07:00 UTC: UTC-4:00 EDT
+    {3056335200UL, -300},  // 2066-11-07 06:00 UTC: UTC-5:00 EST
+    {3067225200UL, -240},  // 2067-03-13 07:00 UTC: UTC-4:00 EDT
+    {3087784800UL, -300},  // 2067-11-06 06:00 UTC: UTC-5:00 EST
+    {3098674800UL, -240},  // 2068-03-11 07:00 UTC: UTC-4:00 EDT
+    {3119234400UL, -300},  // 2068-11-04 06:00 UTC: UTC-5:00 EST
+    {3130124400UL, -240},  // 2069-03-10 07:00 UTC: UTC-4:00 EDT
+    {3150684000UL, -300},  // 2069-11-03 06:00 UTC: UTC-5:00 EST
+    {3161574000UL, -240},  // 2070-03-09 07:00 UTC: UTC-4:00 EDT
+    {3182133600UL, -300},  // 2070-11-02 06:00 UTC: UTC-5:00 EST
+    {3193023600UL, -240},  // 2071-03-08 07:00 UTC: UTC-4:00 EDT
+    {3213583200UL, -300},  // 2071-11-01 06:00 UTC: UTC-5:00 EST
+    {3225078000UL, -240},  // 2072-03-13 07:00 UTC: UTC-4:00 EDT
+    {3245637600UL, -300},  // 2072-11-06 06:00 UTC: UTC-5:00 EST
+    {3256527600UL, -240},  // 2073-03-12 07:00 UTC: UTC-4:00 EDT
+    {3277087200UL, -300},  // 2073-11-05 06:00 UTC: UTC-5:00 EST
+    {3287977200UL, -240},  // 2074-03-11 07:00 UTC: UTC-4:00 EDT
+    {3308536800UL, -300},  // 2074-11-04 06:00 UTC: UTC-5:00 EST
+    {3319426800UL, -240},  // 2075-03-10 07:00 UTC: UTC-4:00 EDT
+    {3339986400UL, -300},  // 2075-11-03 06:00 UTC: UTC-5:00 EST
+    {3350876400UL, -240},  // 2076-03-08 07:00 UTC: UTC-4:00 EDT
+    {3371436000UL, -300},  // 2076-11-01 06:00 UTC: UTC-5:00 EST
+    {3382930800UL, -240},  // 2077-03-14 07:00 UTC: UTC-4:00 EDT
+    {3403490400UL, -300},  // 2077-11-07 06:00 UTC: UTC-5:00 EST
+    {3414380400UL, -240},  // 2078-03-13 07:00 UTC: UTC-4:00 EDT
+    {3434940000UL, -300},  // 2078-11-06 06:00 UTC: UTC-5:00 EST
+    {3445830000UL, -240},  // 2079-03-12 07:00 UTC: UTC-4:00 EDT
+    {3466389600UL, -300},  // 2079-11-05 06:00 UTC: UTC-5:00 EST
+    {3477279600UL, -240},  // 2080-03-10 07:00 UTC: UTC-4:00 EDT
+    {3497839200UL, -300},  // 2080-11-03 06:00 UTC: UTC-5:00 EST
+    {3508729200UL, -240},  // 2081-03-09 07:00 UTC: UTC-4:00 EDT
+    {3529288800UL, -300},  // 2081-11-02 06:00 UTC: UTC-5:00 EST
+    {3540178800UL, -240},  // 2082-03-08 07:00 UTC: UTC-4:00 EDT
+    {3560738400UL, -300},  // 2082-11-01 06:00 UTC: UTC-5:00 EST
+    {3572233200UL, -240},  // 2083-03-14 07:00 UTC: UTC-4:00 EDT
+    {3592792800UL, -300},  // 2083-11-07 06:00 UTC: UTC-5:00 EST
+    {3603682800UL, -240},  // 2084-03-12 07:00 UTC: UTC-4:00 EDT
+    {3624242400UL, -300},  // 2084-11-05 06:00 UTC: UTC-5:00 EST
+    {3635132400UL, -240},  // 2085-03-11 07:00 UTC: UTC-4:00 EDT
+    {3655692000UL, -300},  // 2085-11-04 06:00 UTC: UTC-5:00 EST
+    {3666582000UL, -240},  // 2086-03-10 07:00 UTC: UTC-4:00 EDT
+    {3687141600UL, -300},  // 2086-11-03 06:00 UTC: UTC-5:00 EST
+    {3698031600UL, -240},  // 2087-03-09 07:00 UTC: UTC-4:00 EDT
+    {3718591200UL, -300},  // 2087-11-02 06:00 UTC: UTC-5:00 EST
+    {3730086000UL, -240},  // 2088-03-14 07:00 UTC: UTC-4:00 EDT
+    {3750645600UL, -300},  // 2088-11-07 06:00 UTC: UTC-5:00 EST
+    {3761535600UL, -240},  // 2089-03-13 07:00 UTC: UTC-4:00 EDT
+    {3782095200UL, -300},  // 2089-11-06 06:00 UTC: UTC-5:00 EST
+    {3792985200UL, -240},  // 2090-03-12 07:00 UTC: UTC-4:00 EDT
+    {3813544800UL, -300},  // 2090-11-05 06:00 UTC: UTC-5:00 EST
+    {3824434800UL, -240},  // 2091-03-11 07:00 UTC: UTC-4:00 EDT
+    {3844994400UL, -300},  // 2091-11-04 06:00 UTC: UTC-5:00 EST
+    {3855884400UL, -240},  // 2092-03-09 07:00 UTC: UTC-4:00 EDT
+    {3876444000UL, -300},  // 2092-11-02 06:00 UTC: UTC-5:00 EST
+    {3887334000UL, -240},  // 2093-03-08 07:00 UTC: UTC-4:00 EDT
+    {3907893600UL, -300},  // 2093-11-01 06:00 UTC: UTC-5:00 EST
+    {3919388400UL, -240},  // 2094-03-14 07:00 UTC: UTC-4:00 EDT
+    {3939948000UL, -300},  // 2094-11-07 06:00 UTC: UTC-5:00 EST
+    {3950838000UL, -240},  // 2095-03-13 07:00 UTC: UTC-4:00 EDT
+    {3971397600UL, -300},  // 2095-11-06 06:00 UTC: UTC-5:00 EST
+    {3982287600UL, -240},  // 2096-03-11 07:00 UTC: UTC-4:00 EDT
+    {4002847200UL, -300},  // 2096-11-04 06:00 UTC: UTC-5:00 EST
+    {4013737200UL, -240},  // 2097-03-10 07:00 UTC: UTC-4:00 EDT
+    {4034296800UL, -300},  // 2097-11-03 06:00 UTC: UTC-5:00 EST
+    {4045186800UL, -240},  // 2098-03-09 07:00 UTC: UTC-4:00 EDT
+    {4065746400UL, -300},  // 2098-11-02 06:00 UTC: UTC-5:00 EST
+    {4076636400UL, -240},  // 2099-03-08 07:00 UTC: UTC-4:00 EDT
+    {4097196000UL, -300},  // 2099-11-01 06:00 UTC: UTC-5:00 EST
+};
+
+const uint16_t tz_transition_count = sizeof(tz_transitions) / sizeof(tz_transitions[0]);
+
+#endif  // RTC_UTC
@@ -0,0 +1,162 @@
+
+/**
+ * @brief The watchdog: an interrupt, then a reset
+ *
+ * The watchdog runs in interrupt and system reset mode. The first
+ * time-out runs the WDT interrupt and the hardware clears WDIE, so the
+ * next one resets. The ISR is naked: it reads the interrupted PC from the
+ * stack, saves the post-mortem record and sets a 15ms reset-only time-out,
+ * so the reset follows at once.
+ *
+ * The record lives in .noinit, which the C runtime does not clear and
+ * ram_paint() does not reach. The magic number says it was written by
+ * the ISR and not left over from a power-on.
+ *
+ * Only hangs in main context are recorded. An ISR that hangs runs with
+ * the I bit clear, and an INT0 or INT1 storm outranks the WDT interrupt
+ * (vector 6), so either way the WDT ISR never runs and the second
+ * time-out resets the chip. Such a reset shows up only as a watchdog
+ * reset (WDRF) with no record.
+ */
+
+#include <Arduino.h>
+
+#include "print.h"
+#include "reset.h"
+#include "scheduler.h"
+#include "settings.h"
+#include "timebase.h"
+#include "watchdog.h"
+
+#if WATCHDOG
+
+#ifndef __AVR__
+#error "The watchdog needs the AVR WDT; use WATCHDOG=0"
+#endif
+
+#include <avr/wdt.h>
+
+#ifndef WATCHDOG_TIMEOUT
+#define WATCHDOG_TIMEOUT WDTO_2S
+#endif
+
+#define POST_MORTEM_MAGIC 0xDEADC10CUL
+
+struct post_mortem {
+    uint32_t magic;
+    uint16_t pc;          // Byte address, for avr-addr2line
+    uint8_t task;         // task_id, task_count between tasks
+    uint16_t loop_us;     // The last full pass of loop()
+    uint32_t stalled_ms;  // Since loop() last fed the watchdog
+    uint32_t sqw_seconds; // SQW seconds since boot
+};
+
+static post_mortem record __attribute__((section(".noinit")));
+
+static post_mortem last;  // The record from the reset before this boot, if last.magic is set
+static uint8_t last_flags;  // The causes of the reset before this boot
+
+static volatile uint16_t last_loop_us = 0;
+static volatile unsigned long last_feed_ms = 0;
+
+extern "C" void watchdog_expired(uint16_t pc) __attribute__((noreturn, used));
+
+/**
+ * @brief Save the record and reset; jumped to from the WDT ISR with
+ * interrupts off
+ */
+void watchdog_expired(uint16_t pc) {
+    record.pc = pc << 1;
+    record.task = sched_running();
+    record.loop_us = last_loop_us;
+    record.stalled_ms = millis() - last_feed_ms;
+    record.sqw_seconds = timebase_seconds();
+    record.magic = POST_MORTEM_MAGIC;
+
+    wdt_enable(WDTO_15MS);
+    for (;;)
+        ;
+}
+
+// The return address is the interrupted PC, a word address: high byte at
+// SP+1, low byte at SP+2. This never returns, so no registers are saved.
+ISR(WDT_vect, ISR_NAKED) {
+    asm volatile("clr r1\n\t"
+                 "in r30, __SP_L__\n\t"
+                 "in r31, __SP_H__\n\t"
+                 "ldd r24, Z+2\n\t"
+                 "ldd r25, Z+1\n\t"
+                 "jmp watchdog_expired\n\t");
+}
+
+/**
+ * @brief Report and count the last reset, then start the watchdog; call
+ * at the end of setup()
+ */
+void watchdog_setup() {
+    uint8_t flags = reset_flags();
+
+    if (record.magic == POST_MORTEM_MAGIC) {
+        last = record;
+        record.magic = 0;
+        flags |= reset_watchdog;  // Even if the bootloader cleared MCUSR
+    }
+
+    if (flags == 0 && reset_cold())
+        flags = reset_power_on;
+    last_flags = flags;
+
+    settings s = settings_get();
+    for (uint8_t i = 0; i < sizeof(s.resets); ++i) {
+        if ((flags & _BV(i)) && s.resets[i] < 0xFF)
+            s.resets[i]++;
+    }
+    // A watchdog or brownout reset may well come again before the
+    // deferred write, and take the count with it
+    if (flags & (reset_watchdog | reset_brownout))
+        settings_save_now(s);
+    else
+        settings_save(s);
+
+    if (flags & reset_watchdog)
+        print_watchdog_stats();
+
+    last_feed_ms = millis();
+
+    // Changing the mode takes the timed sequence
+    cli();
+    wdt_reset();
+    WDTCSR = _BV(WDCE) | _BV(WDE);
+    WDTCSR = _BV(WDIE) | _BV(WDE) | (WATCHDOG_TIMEOUT & 0x08 ? _BV(WDP3) : 0) | (WATCHDOG_TIMEOUT & 0x07);
+    sei();
+}
+
+/**
+ * @brief Feed the watchdog; call from loop() with the time the pass took
+ */
+void watchdog_feed(uint16_t loop_us) {
+    wdt_reset();
+    last_loop_us = loop_us;
+    last_feed_ms = millis();
+}
+
+void print_watchdog_stats() {
+    const settings &s = settings_get();
+    PRINT("Resets: power-on %u, external %u, brownout %u, watchdog %u\n", s.resets[0], s.resets[1], s.resets[2],
+          s.resets[3]);
+
+    if (last.magic != POST_MORTEM_MAGIC) {
+        if (last_flags & reset_watchdog)
+            PRINT("Watchdog reset with no record: a hang in an ISR\n");
+        else
+            PRINT("The last reset was not the watchdog's\n");
+        return;
+    }
+
+    char name[SCHED_NAME_MAX];
+    sched_task_name(last.task, name);
+    PRINT("Watchdog reset: task %s, pc 0x%04x, loop %uus, stalled %lums, SQW second %lu\n", name, last.pc,
+          last.loop_us, last.stalled_ms, last.sqw_seconds);
+}
+
+#endif  // WATCHDOG
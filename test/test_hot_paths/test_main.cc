@@ -0,0 +1,214 @@
+
+/**
+ * @brief Unity tests for the hot paths the bench times: the shift register
+ * output, the time update and print
+ *
+ * Run with 'pio test -e native'. The 595 chain is modelled from the pin
+ * toggles, so these check what the tubes would show, not just how many
+ * pins moved.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "native_hal.h"
+#include "RTC.h"
+#include "brightness.h"
+#include "display.h"
+#include "pins.h"
+#include "print.h"
+#include "shift_register.h"
+#include "timebase.h"
+
+// Defined in src/, but not declared in a header
+void setup();
+void loop();
+
+// 2024-08-15 16:34:56 UTC, 12:34:56 EDT in the native env's time zone
+#define TEST_TIME 1723739696UL
+
+static uint32_t rtc_time = TEST_TIME;
+
+// The 595 chain: bits shift in on a rising SERIAL_CLK and are copied to
+// the outputs on a rising REGISTER_CLK
+static uint32_t chain_shift = 0;
+static uint32_t chain_latched = 0;
+static unsigned int chain_latches = 0;
+
+static void chain_model(uint8_t pin, uint8_t level) {
+    if (pin == SERIAL_CLK && level == HIGH) {
+        chain_shift = (chain_shift << 1) | hal_pin_level(SERIAL_DATA);
+    } else if (pin == REGISTER_CLK && level == HIGH) {
+        chain_latched = chain_shift;
+        chain_latches++;
+    }
+}
+
+// The byte stage 'n' of the chain shows; stage 0 is sent first, so it is
+// the farthest from the MCU
+static uint8_t chain_stage(uint8_t n) {
+    return chain_latched >> (8 * (DISPLAY_STAGES - 1 - n));
+}
+
+static void sqw_edge(int level) {
+    if (level == HIGH)
+        hal_rtc_set(++rtc_time);
+    hal_advance_millis(500);
+    hal_fire_pin(CLOCK_1HZ, level);
+}
+
+static void drain_log() {
+    do {
+        log_drain();
+    } while (log_pending());
+}
+
+void setUp() {
+    hal_on_toggle(chain_model);
+    chain_latches = 0;
+    drain_log();
+    hal_serial_clear();
+}
+
+void tearDown() {
+}
+
+void test_shift_register_sends_msb_first() {
+    static const uint8_t data[] = {0xA5, 0x5A};
+    hal_reset_counters();
+
+    updateShiftRegister(data, sizeof(data));
+
+    TEST_ASSERT_EQUAL_UINT(1, chain_latches);
+    TEST_ASSERT_EQUAL_HEX32(0xA55A, chain_latched & 0xFFFF);
+    TEST_ASSERT_EQUAL_UINT(32, hal_get_counters().pin_toggles[SERIAL_CLK]);
+    TEST_ASSERT_EQUAL_INT(HIGH, hal_pin_level(REGISTER_CLK));
+    TEST_ASSERT_EQUAL_INT(LOW, hal_pin_level(SERIAL_DATA));
+}
+
+void test_time_update_shows_local_time() {
+    update_display_with_time();
+    display_commit();
+
+#if DISPLAY_TUBES == 6
+    TEST_ASSERT_EQUAL_HEX8(0x56, chain_stage(0));
+    TEST_ASSERT_EQUAL_HEX8(0x34, chain_stage(1));
+    TEST_ASSERT_EQUAL_HEX8(0x12, chain_stage(2));
+#else
+    TEST_ASSERT_EQUAL_HEX8(0x34, chain_stage(0));
+    TEST_ASSERT_EQUAL_HEX8(0x12, chain_stage(1));
+#endif
+}
+
+// RTC_setup() reads the RTC at some point in the second, and after a warm
+// reset nothing comes between that and the first falling edge, which may
+// come at once and must still count
+void test_time_update_counts_the_first_edge() {
+    RTC_setup();
+    hal_advance_millis(100);
+    hal_fire_pin(CLOCK_1HZ, HIGH);
+    loop();
+    hal_rtc_set(++rtc_time);
+    hal_advance_millis(100);
+    hal_fire_pin(CLOCK_1HZ, LOW);
+    loop();
+
+    TEST_ASSERT_EQUAL_UINT(1, chain_latches);
+    TEST_ASSERT_EQUAL_HEX8(DISPLAY_TUBES == 6 ? 0x57 : 0x34, chain_stage(0));
+}
+
+// Each second the time task sends one new frame, and only once
+void test_time_update_follows_the_sqw() {
+    for (int i = 0; i < 5; ++i) {
+        sqw_edge(HIGH);
+        loop();
+        sqw_edge(LOW);
+        loop();
+    }
+
+    TEST_ASSERT_EQUAL_UINT(5, chain_latches);
+#if DISPLAY_TUBES == 6
+    TEST_ASSERT_EQUAL_HEX8(0x02, chain_stage(0));
+    TEST_ASSERT_EQUAL_HEX8(0x35, chain_stage(1));
+#endif
+}
+
+void test_print_formats() {
+    PRINT("%02d:%02d:%02d %S %-4s|%5u %lx %f\n", 12, 3, 56, F("flash"), "ram", 42U, 0xBEEFUL,
+          print_fixed_point<2>(-1234));
+    drain_log();
+
+    TEST_ASSERT_EQUAL_STRING("12:03:56 flash ram |   42 beef -12.34\n", hal_serial_output());
+}
+
+// A message that does not fit is dropped whole, and the drop is reported
+// once the ring has drained
+void test_print_drops_when_full() {
+    for (int i = 0; i < 20; ++i)
+        PRINT("message %02d\n", i);
+    drain_log();
+    drain_log();
+
+    const char *out = hal_serial_output();
+    TEST_ASSERT_NOT_NULL(strstr(out, "message 00\n"));
+    TEST_ASSERT_NULL(strstr(out, "message 19\n"));
+    TEST_ASSERT_NOT_NULL(strstr(out, " messages dropped\n"));
+}
+
+// After the edges stop, now_ms() runs on; when they come back it holds
+// rather than jumping back to the count of edges
+void test_now_ms_never_goes_back() {
+    uint32_t before = now_ms();
+    hal_advance_millis(2300);
+    uint32_t late = now_ms();
+    TEST_ASSERT_GREATER_OR_EQUAL(before + 2000, late);
+
+    sqw_edge(HIGH);
+    sqw_edge(LOW);
+    loop();
+    TEST_ASSERT_GREATER_OR_EQUAL(late, now_ms());
+}
+
+#if BRIGHTNESS_RAMP_MS
+// A ramp takes BRIGHTNESS_RAMP_MS of now_ms() time, one tick per ms
+void test_brightness_ramp() {
+    brightness_restore(BRIGHTNESS_FULL);
+    brightness_set(0);
+
+    int last = hal_analog_value(HV_PWM_CONTROL);
+    for (int ms = 0; ms < BRIGHTNESS_RAMP_MS / 2; ++ms) {
+        hal_advance_millis(1);
+        brightness_tick();
+        TEST_ASSERT_LESS_OR_EQUAL(last, hal_analog_value(HV_PWM_CONTROL));
+        last = hal_analog_value(HV_PWM_CONTROL);
+    }
+    TEST_ASSERT_GREATER_THAN(0, last);
+    TEST_ASSERT_LESS_THAN(255, last);
+
+    for (int ms = 0; ms < BRIGHTNESS_RAMP_MS / 2 + 2; ++ms) {
+        hal_advance_millis(1);
+        brightness_tick();
+    }
+    TEST_ASSERT_EQUAL_INT(0, hal_analog_value(HV_PWM_CONTROL));
+}
+#endif
+
+int main() {
+    hal_reset();
+    hal_serial_mute(true);
+    hal_rtc_set(rtc_time);
+    setup();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_shift_register_sends_msb_first);
+    RUN_TEST(test_time_update_shows_local_time);
+    RUN_TEST(test_time_update_counts_the_first_edge);
+    RUN_TEST(test_time_update_follows_the_sqw);
+    RUN_TEST(test_print_formats);
+    RUN_TEST(test_print_drops_when_full);
+    RUN_TEST(test_now_ms_never_goes_back);
+#if BRIGHTNESS_RAMP_MS
+    RUN_TEST(test_brightness_ramp);
+#endif
+    return UNITY_END();
+}
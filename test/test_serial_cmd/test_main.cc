@@ -0,0 +1,103 @@
+
+/**
+ * @brief Unity tests for the serial commands: every reply gets out whole
+ *
+ * Run with 'pio test -e native'. A reply longer than the log ring must
+ * wait for the UART rather than lose lines, and so must a batch of
+ * commands that arrive together.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "native_hal.h"
+#include "print.h"
+
+// Defined in src/, but not declared in a header
+void setup();
+void loop();
+
+// The one-letter commands this build has, and '?' for the help
+static const char commands[] = "tbglke?"
+#if RTC_ASYNC
+                               "i"
+#endif
+#if DISPLAY_REFRESH_HZ
+                               "d"
+#endif
+#if POWER_STATS
+                               "z"
+#endif
+#if HV_PS
+                               "h"
+#endif
+#if PROFILE
+                               "p"
+#endif
+#if RAM_CHECK
+                               "m"
+#endif
+#if WATCHDOG
+                               "w"
+#endif
+    ;
+
+static void run(const char *input) {
+    hal_serial_clear();
+    hal_serial_input(input);
+    for (int i = 0; i < 100; ++i) {
+        hal_advance_millis(1);
+        loop();
+    }
+}
+
+static void assert_nothing_dropped() {
+    TEST_ASSERT_NULL_MESSAGE(strstr(hal_serial_output(), " messages dropped\n"), hal_serial_output());
+
+    run("l");
+    TEST_ASSERT_NOT_NULL_MESSAGE(strstr(hal_serial_output(), ", 0 dropped\n"), hal_serial_output());
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_help_is_whole() {
+    run("?");
+
+    const char *out = hal_serial_output();
+    TEST_ASSERT_NOT_NULL(strstr(out, "Commands: T<token> ping"));
+    TEST_ASSERT_NOT_NULL(strstr(out, "e settings"));
+    assert_nothing_dropped();
+}
+
+void test_each_command() {
+    char input[2] = {0, 0};
+    for (const char *c = commands; *c; ++c) {
+        input[0] = *c;
+        run(input);
+        TEST_ASSERT_GREATER_THAN(0, strlen(hal_serial_output()));
+        assert_nothing_dropped();
+    }
+}
+
+void test_all_commands_at_once() {
+    run(commands);
+    assert_nothing_dropped();
+}
+
+int main() {
+    hal_reset();
+    hal_serial_mute(true);
+    hal_rtc_set(1723739696UL);
+    setup();
+    run("");
+
+    UNITY_BEGIN();
+    RUN_TEST(test_help_is_whole);
+    RUN_TEST(test_each_command);
+    RUN_TEST(test_all_commands_at_once);
+    return UNITY_END();
+}
@@ -0,0 +1,84 @@
+
+/**
+ * @brief Unity tests for the serial time sync ('S<seconds> <delay ms>')
+ *
+ * Run with 'pio test -e native'. The SQW runs throughout, falling at 300ms
+ * into each millis() second and rising at 800ms, so its edges land
+ * between a command and the time it is due.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "native_hal.h"
+#include "pins.h"
+
+// Defined in src/, but not declared in a header
+void setup();
+void loop();
+
+static char command[32];
+
+// One ms of the clock: the SQW, then a pass of loop()
+static void tick() {
+    hal_advance_millis(1);
+    unsigned long ms = millis() % 1000;
+    if (ms == 300)
+        hal_fire_pin(CLOCK_1HZ, LOW);
+    else if (ms == 800)
+        hal_fire_pin(CLOCK_1HZ, HIGH);
+    loop();
+}
+
+/**
+ * @brief Send a time sync and run until its reply
+ * @return The ms from the command to the reply, or 0 if none came
+ */
+static unsigned long sync_after(unsigned long phase_ms, int delay_ms) {
+    while (millis() % 1000 != phase_ms)
+        tick();
+
+    snprintf(command, sizeof(command), "S1723690000 %d\n", delay_ms);
+    hal_serial_clear();
+    hal_serial_input(command);
+    tick();  // The serial task reads the command
+    unsigned long start = millis();
+
+    while (millis() - start < 3UL * delay_ms) {
+        tick();
+        if (strstr(hal_serial_output(), "S 1723690000 "))
+            return millis() - start;
+    }
+    return 0;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// The falling edge at 300ms and the rising one at 800ms both come before
+// the sync is due
+void test_sync_with_edges_before_it_is_due() {
+    TEST_ASSERT_UINT_WITHIN(1, 900, sync_after(0, 900));
+}
+
+// From 350ms to 750ms there is no edge
+void test_sync_without_edges_before_it_is_due() {
+    TEST_ASSERT_UINT_WITHIN(1, 400, sync_after(350, 400));
+}
+
+int main() {
+    hal_reset();
+    hal_serial_mute(true);
+    hal_rtc_set(1723680000UL);
+    setup();
+    for (int i = 0; i < 3000; ++i)
+        tick();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_sync_with_edges_before_it_is_due);
+    RUN_TEST(test_sync_without_edges_before_it_is_due);
+    return UNITY_END();
+}
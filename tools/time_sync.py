@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""Set a clock's RTC from this host's time over the serial port.
+
+The clock answers 'T<token>' with its time; the round trip time of each
+ping gives an estimate of the clock's offset from this host. The ping with
+the shortest round trip is used. Then 'S<seconds> <delay ms>' asks the clock
+to set its RTC to the host's next whole second, timed so the write lands on
+that second.
+
+Each run prints (and with --log appends to a file) the offset before the
+sync, so the drift of each clock can be tracked over time.
+
+The RTC is set to UTC; the clock's tz table (tools/tz_table.py) gives the
+local time. Use --local for firmware built with RTC_UTC=0.
+
+    tools/time_sync.py /dev/ttyUSB0
+    tools/time_sync.py /dev/ttyUSB0 --check --log drift.log
+
+Linux only; uses termios, no pyserial needed. The host should be running
+NTP or similar.
+"""
+
+import argparse
+import os
+import select
+import sys
+import termios
+import time
+
+BAUD = termios.B115200
+
+
+def open_port(path):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    attrs = termios.tcgetattr(fd)
+    attrs[0] = 0                                   # iflag
+    attrs[1] = 0                                   # oflag
+    attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+    attrs[3] = 0                                   # lflag: raw
+    attrs[4] = BAUD
+    attrs[5] = BAUD
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+class Clock:
+    def __init__(self, fd):
+        self.fd = fd
+        self.buffer = b""
+
+    def send(self, text):
+        os.write(self.fd, text.encode())
+
+    def read_line(self, timeout):
+        """Return the next line, or None after timeout seconds"""
+        end = time.time() + timeout
+        while b"\n" not in self.buffer:
+            left = end - time.time()
+            if left <= 0:
+                return None
+            ready, _, _ = select.select([self.fd], [], [], left)
+            if ready:
+                self.buffer += os.read(self.fd, 256)
+        line, self.buffer = self.buffer.split(b"\n", 1)
+        return line.decode(errors="replace").strip()
+
+    def expect(self, prefix, timeout=2.0):
+        """Return the fields of the next reply that starts with prefix"""
+        end = time.time() + timeout
+        while time.time() < end:
+            line = self.read_line(end - time.time())
+            if line is None:
+                break
+            fields = line.split()
+            if fields and fields[0] == prefix:
+                return fields[1:], time.time()
+        return None, time.time()
+
+    def discard_input(self):
+        termios.tcflush(self.fd, termios.TCIFLUSH)
+        self.buffer = b""
+
+
+def host_time(utc):
+    """The host time, in the time zone the RTC keeps"""
+    now = time.time()
+    if not utc:
+        now += time.localtime(now).tm_gmtoff
+    return now
+
+
+def measure(clock, pings, utc):
+    """Return (offset, rtt) in seconds for the ping with the shortest round trip"""
+    best = None
+    for token in range(pings):
+        sent = host_time(utc)
+        clock.send("T%d\n" % token)
+        fields, _ = clock.expect("T")
+        received = host_time(utc)
+        if fields is None or int(fields[0]) != token:
+            continue
+        rtt = received - sent
+        clock_time = int(fields[1]) + int(fields[2]) / 1000.0
+        offset = clock_time - (sent + rtt / 2)
+        if best is None or rtt < best[1]:
+            best = (offset, rtt)
+        time.sleep(0.05)
+    return best
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("port", help="the clock's serial port, e.g. /dev/ttyUSB0")
+    parser.add_argument("--pings", type=int, default=8, help="pings to estimate the offset (8)")
+    parser.add_argument("--wait", type=float, default=3.0,
+                        help="seconds to wait for the clock to boot after the port opens (3)")
+    parser.add_argument("--check", action="store_true", help="report the offset, do not set the clock")
+    zone = parser.add_mutually_exclusive_group()
+    zone.add_argument("--utc", dest="utc", action="store_true", default=True,
+                      help="the RTC keeps UTC, firmware built with RTC_UTC=1 (the default)")
+    zone.add_argument("--local", dest="utc", action="store_false",
+                      help="the RTC keeps local time, firmware built with RTC_UTC=0")
+    parser.add_argument("--log", help="append the offset to this file")
+    args = parser.parse_args()
+
+    clock = Clock(open_port(args.port))
+    time.sleep(args.wait)  # Opening the port resets most boards
+    clock.discard_input()
+
+    before = measure(clock, args.pings, args.utc)
+    if before is None:
+        sys.exit("%s: no answer from the clock" % args.port)
+    offset, rtt = before
+    print("%s: offset %+.1f ms, round trip %.1f ms" % (args.port, offset * 1000, rtt * 1000))
+
+    if args.log:
+        with open(args.log, "a") as log:
+            log.write("%s %s %+.1f %.1f\n" % (time.strftime("%Y-%m-%dT%H:%M:%S"), args.port,
+                                                offset * 1000, rtt * 1000))
+
+    if args.check:
+        return
+
+    # Set the time to a whole second at least 1s away; the request takes
+    # about half a round trip to arrive.
+    sent = host_time(args.utc)
+    target = int(sent) + 2
+    delay_ms = round((target - sent - rtt / 2) * 1000)
+    clock.send("S%d %d\n" % (target, delay_ms))
+    fields, _ = clock.expect("S", timeout=delay_ms / 1000.0 + 2)
+    if fields is None:
+        sys.exit("%s: the clock did not confirm the new time" % args.port)
+    print("%s: set to %s, the clock was %+d ms off" % (args.port, time.strftime(
+        "%Y-%m-%d %H:%M:%S", time.gmtime(int(fields[0]))), int(fields[1])))
+
+    after = measure(clock, args.pings, args.utc)
+    if after is not None:
+        print("%s: offset now %+.1f ms" % (args.port, after[0] * 1000))
+
+
+if __name__ == "__main__":
+    main()
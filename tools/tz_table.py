@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Write src/tz_table.cc, the clock's time zone table, for a zone.
+
+With RTC_UTC=1 the RTC keeps UTC and the clock shows local time using a
+table of the zone's UTC offset changes (DST starts and ends). The table
+comes from the host's tz database, so it follows the zone's real rules,
+including past and announced changes:
+
+    tools/tz_table.py America/New_York > src/tz_table.cc
+    tools/tz_table.py Europe/Berlin --first-year 2025 --last-year 2060 > src/tz_table.cc
+
+Each entry is a UTC time (seconds since 1970) and the offset, in minutes,
+that starts then. The first entry, at 0, holds the offset at the start of
+the first year. Two entries per year for a zone with DST; 2024 - 2099 is
+about 900 bytes of flash.
+"""
+
+import argparse
+import datetime
+import sys
+import zoneinfo
+
+UTC = datetime.timezone.utc
+
+
+def offset_minutes(zone, t):
+    """The zone's UTC offset at UTC time t (seconds), in minutes"""
+    local = datetime.datetime.fromtimestamp(t, UTC).astimezone(zone)
+    return int(local.utcoffset().total_seconds()) // 60, local.tzname()
+
+
+def transitions(zone, first_year, last_year):
+    """The (utc, offset, name) changes from first_year to the end of last_year"""
+    start = int(datetime.datetime(first_year, 1, 1, tzinfo=UTC).timestamp())
+    end = int(datetime.datetime(last_year + 1, 1, 1, tzinfo=UTC).timestamp())
+
+    offset, name = offset_minutes(zone, start)
+    result = [(0, offset, name)]
+
+    # Changes are months apart; step by a day, then find the second
+    day = 86400
+    t = start
+    while t < end:
+        next_offset, next_name = offset_minutes(zone, t + day)
+        if next_offset != offset or next_name != name:
+            lo, hi = t, t + day  # The offset at lo is the old one, at hi the new one
+            while hi - lo > 1:
+                mid = (lo + hi) // 2
+                if offset_minutes(zone, mid) == (offset, name):
+                    lo = mid
+                else:
+                    hi = mid
+            offset, name = next_offset, next_name
+            result.append((hi, offset, name))
+        t += day
+    return result
+
+
+def utc_offset_text(minutes):
+    sign = "-" if minutes < 0 else "+"
+    return "UTC%s%d:%02d" % (sign, abs(minutes) // 60, abs(minutes) % 60)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("zone", help="a tz database zone, e.g. America/New_York")
+    parser.add_argument("--first-year", type=int, default=2024, help="the first year in the table (2024)")
+    parser.add_argument("--last-year", type=int, default=2099, help="the last year in the table (2099)")
+    args = parser.parse_args()
+
+    try:
+        zone = zoneinfo.ZoneInfo(args.zone)
+    except zoneinfo.ZoneInfoNotFoundError:
+        sys.exit("Unknown zone: %s" % args.zone)
+
+    if not 1970 <= args.first_year <= args.last_year <= 2105:
+        sys.exit("The years must be in 1970 - 2105, first to last")
+
+    table = transitions(zone, args.first_year, args.last_year)
+
+    print()
+    print("/**")
+    print(" * @brief The time zone table for %s, %d - %d" % (args.zone, args.first_year, args.last_year))
+    print(" *")
+    print(" * Made by tools/tz_table.py; to change the zone or the years, run")
+    print(" *   tools/tz_table.py %s > src/tz_table.cc" % args.zone)
+    print(" */")
+    print()
+    print("#include <Arduino.h>")
+    print()
+    print('#include "tz.h"')
+    print()
+    print("#if RTC_UTC")
+    print()
+    print('const char tz_name[] PROGMEM = "%s";' % args.zone)
+    print()
+    print("const tz_transition tz_transitions[] PROGMEM = {")
+    for utc, offset, name in table:
+        when = datetime.datetime.fromtimestamp(utc, UTC).strftime("%Y-%m-%d %H:%M")
+        entry = "{%dUL, %d}," % (utc, offset)
+        print("    %-22s // %s UTC: %s %s" % (entry, when, utc_offset_text(offset), name))
+    print("};")
+    print()
+    print("const uint16_t tz_transition_count = sizeof(tz_transitions) / sizeof(tz_transitions[0]);")
+    print()
+    print("#endif  // RTC_UTC")
+
+
+if __name__ == "__main__":
+    main()